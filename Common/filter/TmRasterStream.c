@@ -0,0 +1,374 @@
+/**********************************************************************************************************************
+ * 
+ * Epson TM Printer Driver (ESC/POS) for Linux
+ * 
+ * Copyright (C) Seiko Epson Corporation 2019.
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ * 
+ *********************************************************************************************************************/
+#include "TmRasterStream.h"
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Result code (Same values as the filters)
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_SUCCESS (0)	// Processing succeeded.
+#define EPTMD_FAILED (-1)	// Processing failed.
+#define EPTMD_CANCEL (-2)	// Processing canceled.
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Raster stream
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_RASTER_HEADER_SIZE  (1796)	// sizeof(cups_page_header2_t) : Page header size in all versions.
+#define EPTMD_RASTER_HEADER_WORDS (81)		// Numeric words of the page header. (AdvanceDistance to cupsReal)
+#define EPTMD_RASTER_MAX_BPP      (30)		// Bytes per pixel. (240 bits)
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Static function prototype declaration
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int  DecodeLine(EPTMS_RASTER_STREAM_T*, unsigned char*, unsigned);
+static int  HasInk(unsigned char*, unsigned long);
+static unsigned ReadStream(EPTMS_RASTER_STREAM_T*, unsigned char*, unsigned);
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Open raster stream. (Formats other than RaSt, RaS2 and RaS3 are left to libcups.)
+ *-------------------------------------------------------------------------------------------------------------------*/
+EPTMS_RASTER_STREAM_T* OpenRasterStream(int fd)
+{
+	EPTMS_RASTER_STREAM_T* p_stream = (EPTMS_RASTER_STREAM_T*)malloc( sizeof(EPTMS_RASTER_STREAM_T) );
+	if ( NULL == p_stream ) {
+		return NULL;
+	}
+	memset( p_stream, 0, sizeof(EPTMS_RASTER_STREAM_T) );
+	p_stream->fd = fd;
+	
+	// Read the synchronization word. (It stays in the buffer for libcups.)
+	while ( sizeof(unsigned int) > p_stream->len ) {
+		ssize_t size = read( fd, (p_stream->buffer + p_stream->len), (sizeof(unsigned int) - p_stream->len) );
+		if ( 0 > size ) {
+			if ( EINTR == errno ) {
+				continue;
+			}
+			break;
+		}
+		else if ( 0 == size ) {
+			break;
+		}
+		else {}
+		p_stream->len += (unsigned)size;
+	}
+	if ( sizeof(unsigned int) > p_stream->len ) {
+		return p_stream;
+	}
+	
+	unsigned int sync;
+	memcpy( &sync, p_stream->buffer, sizeof(sync) );
+	switch ( sync )
+	{
+		case CUPS_RASTER_SYNC:								// RaS3
+		case CUPS_RASTER_SYNCv1:							// RaSt
+			p_stream->native = 1;
+			break;
+		case CUPS_RASTER_REVSYNC:
+		case CUPS_RASTER_REVSYNCv1:
+			p_stream->native  = 1;
+			p_stream->swapped = 1;
+			break;
+		case CUPS_RASTER_SYNCv2:							// RaS2
+			p_stream->native     = 1;
+			p_stream->compressed = 1;
+			break;
+		case CUPS_RASTER_REVSYNCv2:
+			p_stream->native     = 1;
+			p_stream->swapped    = 1;
+			p_stream->compressed = 1;
+			break;
+		default:
+			break;
+	}
+	if ( 0 != p_stream->native ) {
+		p_stream->pos = sizeof(sync);
+	}
+	
+	fprintf( stderr, "DEBUG: Raster stream = %08x (%s)\n", sync, (0 != p_stream->native) ? "filter" : "libcups" );
+	
+	return p_stream;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read page header from raster stream. (Same checks as libcups)
+ *-------------------------------------------------------------------------------------------------------------------*/
+unsigned ReadStreamHeader(EPTMS_RASTER_STREAM_T* p_stream, cups_page_header_t* p_header)
+{
+	unsigned char data[EPTMD_RASTER_HEADER_SIZE];
+	
+	if ( sizeof(data) != ReadStream( p_stream, data, sizeof(data) ) ) {
+		return 0;
+	}
+	
+	if ( 0 != p_stream->swapped ) { // Numeric words after the 4 strings (MediaClass, MediaColor, MediaType, OutputType)
+		unsigned i;
+		for ( i = (64 * 4); ((64 * 4) + (EPTMD_RASTER_HEADER_WORDS * 4)) > i; i += 4 ) {
+			unsigned char temp;
+			temp = data[i + 0]; data[i + 0] = data[i + 3]; data[i + 3] = temp;
+			temp = data[i + 1]; data[i + 1] = data[i + 2]; data[i + 2] = temp;
+		}
+	}
+	memcpy( p_header, data, sizeof(cups_page_header_t) );
+	
+	if ( CUPS_ORDER_CHUNKED == p_header->cupsColorOrder ) {
+		p_stream->bpp = (p_header->cupsBitsPerPixel + 7) / 8;
+	}
+	else {
+		p_stream->bpp = (p_header->cupsBitsPerColor + 7) / 8;
+	}
+	
+	if ( (0 == p_stream->bpp) || (EPTMD_RASTER_MAX_BPP < p_stream->bpp) || (16 < p_header->cupsBitsPerColor)
+	  || (0 == p_header->cupsBytesPerLine) || (0 == p_header->cupsHeight)
+	  || (0 != (p_header->cupsBytesPerLine % p_stream->bpp))
+	  || (p_header->cupsBytesPerLine != ((p_header->cupsWidth * p_header->cupsBitsPerPixel + 7) / 8)) ) {
+		return 0;
+	}
+	
+	switch ( p_header->cupsColorSpace )
+	{
+		case CUPS_CSPACE_W:
+		case CUPS_CSPACE_SW:
+		case CUPS_CSPACE_RGB:
+		case CUPS_CSPACE_SRGB:
+		case CUPS_CSPACE_RGBW:
+		case CUPS_CSPACE_ADOBERGB:
+			p_stream->clearValue = 0xFF;	// White
+			break;
+		default:
+			p_stream->clearValue = 0x00;
+			break;
+	}
+	
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Decode raster of one page into page buffer. (Returns EPTMD_FAILED if the stream is broken)
+ *-------------------------------------------------------------------------------------------------------------------*/
+int DecodeRaster(cups_page_header_t* p_header, EPTMS_RASTER_STREAM_T* p_stream, unsigned char* p_pageBuffer, unsigned LineSize, EPTMS_INK_LINES_T* p_inkLines)
+{
+	unsigned BytesPerLine = p_header->cupsBytesPerLine;
+	
+	p_inkLines->known = 0;
+	p_inkLines->top   = p_header->cupsHeight;
+	p_inkLines->end   = 0;
+	
+	unsigned y = 0;
+	while ( y < p_header->cupsHeight ) {
+		if ( 0 != g_TmCanceled ) {
+			return EPTMD_CANCEL;
+		}
+		
+		unsigned char* p_line = p_pageBuffer + (LineSize * y);
+		unsigned       lines  = 1;
+		int            ink    = 0;
+		
+		if ( 0 != p_stream->compressed ) {
+			unsigned char count = 0;
+			if ( 1 != ReadStream( p_stream, &count, 1 ) ) {
+				fprintf( stderr, "DEBUG: DecodeRaster() = %u/%u\n", (y + 1), p_header->cupsHeight );
+				return EPTMD_FAILED;
+			}
+			lines = (unsigned)count + 1;	// Line repeat count
+			
+			ink = DecodeLine( p_stream, p_line, BytesPerLine );
+			if ( 0 > ink ) {
+				fprintf( stderr, "DEBUG: DecodeRaster() = %u/%u\n", (y + 1), p_header->cupsHeight );
+				return EPTMD_FAILED;
+			}
+		}
+		else {
+			if ( BytesPerLine != ReadStream( p_stream, p_line, BytesPerLine ) ) {
+				fprintf( stderr, "DEBUG: DecodeRaster() = %u/%u\n", (y + 1), p_header->cupsHeight );
+				return EPTMD_FAILED;
+			}
+			ink = HasInk( p_line, BytesPerLine );
+		}
+		
+		if ( lines > (p_header->cupsHeight - y) ) { // A repeat does not continue to the next page.
+			lines = p_header->cupsHeight - y;
+		}
+		unsigned i;
+		for ( i = 1; i < lines; i++ ) {
+			memcpy( (p_line + (LineSize * i)), p_line, BytesPerLine );
+		}
+		
+		if ( 0 != ink ) {
+			if ( p_inkLines->top > y ) {
+				p_inkLines->top = y;
+			}
+			p_inkLines->end = y + lines;
+		}
+		y += lines;
+	}
+	
+	p_inkLines->known = 1;
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Decode one run-length encoded line. (Returns 1 if the line has ink, 0 if blank, EPTMD_FAILED on error)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int DecodeLine(EPTMS_RASTER_STREAM_T* p_stream, unsigned char* p_line, unsigned size)
+{
+	unsigned bpp = p_stream->bpp;
+	unsigned x   = 0;
+	int      ink = 0;
+	
+	while ( x < size ) {
+		unsigned char count = 0;
+		if ( 1 != ReadStream( p_stream, &count, 1 ) ) {
+			return EPTMD_FAILED;
+		}
+		
+		if ( 128 == count ) { // Clear to end of line
+			memset( (p_line + x), p_stream->clearValue, (size - x) );
+			ink |= (0x00 != p_stream->clearValue) ? 1 : 0;
+			break;
+		}
+		else if ( 128 > count ) { // Repeat one pixel (count + 1) times
+			unsigned length = ((unsigned)count + 1) * bpp;
+			if ( length > (size - x) ) { // The pixel is read, only the repeat is cut.
+				length = size - x;
+			}
+			if ( bpp > length ) {
+				return EPTMD_FAILED;
+			}
+			if ( bpp != ReadStream( p_stream, (p_line + x), bpp ) ) {
+				return EPTMD_FAILED;
+			}
+			ink |= HasInk( (p_line + x), bpp );
+			
+			if ( 1 == bpp ) {
+				memset( (p_line + x + 1), p_line[x], (length - 1) );
+			}
+			else {
+				unsigned copied = bpp;
+				while ( copied < length ) { // Double the copied pixels
+					unsigned n = (copied < (length - copied)) ? copied : (length - copied);
+					memcpy( (p_line + x + copied), (p_line + x), n );
+					copied += n;
+				}
+			}
+			x += length;
+		}
+		else { // Literal (257 - count) pixels
+			unsigned length = (257 - (unsigned)count) * bpp;
+			if ( length > (size - x) ) { // The rest of the pixels would be read as the next line.
+				return EPTMD_FAILED;
+			}
+			if ( length != ReadStream( p_stream, (p_line + x), length ) ) {
+				return EPTMD_FAILED;
+			}
+			ink |= HasInk( (p_line + x), length );
+			x += length;
+		}
+	}
+	
+	if ( x < size ) { // Short line
+		memset( (p_line + x), 0x00, (size - x) );
+	}
+	
+	return ink;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Check if data has ink.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int HasInk(unsigned char* p_data, unsigned long data_size)
+{
+	unsigned char bits = 0x00;
+	
+	unsigned long i;
+	for ( i = 0; i < data_size; i++ ) { // No early exit, so that the loop can be vectorized.
+		bits |= p_data[i];
+	}
+	
+	return (0x00 != bits) ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read data from raster stream.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static unsigned ReadStream(EPTMS_RASTER_STREAM_T* p_stream, unsigned char* p_data, unsigned size)
+{
+	unsigned count = 0;
+	
+	while ( size > count ) {
+		if ( p_stream->pos >= p_stream->len ) {
+			ssize_t result = read( p_stream->fd, p_stream->buffer, sizeof(p_stream->buffer) );
+			if ( 0 > result ) {
+				if ( EINTR == errno ) {
+					continue;
+				}
+				break;
+			}
+			else if ( 0 == result ) {
+				break;
+			}
+			else {}
+			p_stream->pos = 0;
+			p_stream->len = (unsigned)result;
+		}
+		
+		unsigned length = p_stream->len - p_stream->pos;
+		if ( length > (size - count) ) {
+			length = size - count;
+		}
+		memcpy( (p_data + count), (p_stream->buffer + p_stream->pos), length );
+		p_stream->pos += length;
+		count += length;
+	}
+	
+	return count;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read callback for libcups. (Returns the buffered data first)
+ *-------------------------------------------------------------------------------------------------------------------*/
+ssize_t ReadStreamIO(void* p_context, unsigned char* p_data, size_t size)
+{
+	EPTMS_RASTER_STREAM_T* p_stream = (EPTMS_RASTER_STREAM_T*)p_context;
+	
+	if ( p_stream->pos < p_stream->len ) {
+		size_t length = p_stream->len - p_stream->pos;
+		if ( length > size ) {
+			length = size;
+		}
+		memcpy( p_data, (p_stream->buffer + p_stream->pos), length );
+		p_stream->pos += (unsigned)length;
+		return (ssize_t)length;
+	}
+	
+	ssize_t result;
+	do {
+		result = read( p_stream->fd, p_data, size );
+	} while ( (0 > result) && (EINTR == errno) );
+	
+	return result;
+}
+/*-------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,68 @@
+/**********************************************************************************************************************
+ * 
+ * Epson TM Printer Driver (ESC/POS) for Linux
+ * 
+ * Copyright (C) Seiko Epson Corporation 2019.
+ * 
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ * 
+ *********************************************************************************************************************/
+#ifndef TM_RASTER_STREAM_H
+#define TM_RASTER_STREAM_H
+
+#include <cups/raster.h>
+#include <sys/types.h>
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Raster stream
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_RASTER_BUFFER_SIZE (65536)	// Input buffer of the raster stream.
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Stracture prototype declaration
+ *-------------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+	int							fd;							// Input file descriptor.
+	int							native;						// Decoded by the filter. (0 : Read by libcups)
+	int							swapped;					// Header words are in the other byte order.
+	int							compressed;					// Lines are run-length encoded. (RaS2)
+	unsigned					bpp;						// Bytes per pixel. (Unit of the run-length)
+	unsigned char				clearValue;					// Value of "clear to end of line".
+	unsigned					pos;						// Read position in buffer.
+	unsigned					len;						// Valid bytes in buffer.
+	unsigned char				buffer[EPTMD_RASTER_BUFFER_SIZE];
+} EPTMS_RASTER_STREAM_T;									// CUPS raster stream (RaSt, RaS2, RaS3)
+
+typedef struct {
+	int							known;						// Found while decoding.
+	unsigned					top;						// First line with ink. (cupsHeight if none)
+	unsigned					end;						// Last line with ink + 1.
+} EPTMS_INK_LINES_T;										// Lines with ink of the page
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Global variable declaration
+ *-------------------------------------------------------------------------------------------------------------------*/
+extern char g_TmCanceled;	// Set by the filter when the job is canceled.
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Function prototype declaration
+ *-------------------------------------------------------------------------------------------------------------------*/
+EPTMS_RASTER_STREAM_T* OpenRasterStream(int);
+unsigned ReadStreamHeader(EPTMS_RASTER_STREAM_T*, cups_page_header_t*);
+int  DecodeRaster(cups_page_header_t*, EPTMS_RASTER_STREAM_T*, unsigned char*, unsigned, EPTMS_INK_LINES_T*);
+ssize_t ReadStreamIO(void*, unsigned char*, size_t);
+
+#endif
+/*-------------------------------------------------------------------------------------------------------------------*/
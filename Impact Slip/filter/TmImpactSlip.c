@@ -29,6 +29,9 @@
 #include <math.h>
 #include <stdlib.h>
 #include <limits.h> // LONG_MAX
+#include <time.h>
+
+#include "TmRasterStream.h"
 
 /*---------------------------------------------------------------------------------------------------------------------
  * Result code
@@ -40,10 +43,18 @@
 /*---------------------------------------------------------------------------------------------------------------------
  * command declaration
  *-------------------------------------------------------------------------------------------------------------------*/
+#define DLE (0x10)
 #define ESC (0x1b)
 #define GS  (0x1d)
 #define FF  (0x0c)
 
+/*---------------------------------------------------------------------------------------------------------------------
+ * Slip insertion
+ *-------------------------------------------------------------------------------------------------------------------*/
+#ifndef EPTMD_INSERTION_TIMEOUT
+#define EPTMD_INSERTION_TIMEOUT (300)	// Seconds to hold an encoded page while waiting for the slip. (Then it is sent anyway.)
+#endif
+
 /*---------------------------------------------------------------------------------------------------------------------
  * enum declaration
  *-------------------------------------------------------------------------------------------------------------------*/
@@ -66,6 +77,16 @@ typedef enum {
 	TmDrawer2,
 } EPTME_DRAWER;												// Drawer No
 
+typedef enum {
+	TmDrawerKickQueued = 0,
+	TmDrawerKickRealTime,
+} EPTME_DRAWER_KICK;										// Drawer Kick Timing
+
+typedef enum {
+	TmSlipReleaseImmediate = 0,
+	TmSlipReleaseOnInsertion,
+} EPTME_SLIP_RELEASE;										// Slip Data Release
+
 /*---------------------------------------------------------------------------------------------------------------------
  * Stracture prototype declaration
  *-------------------------------------------------------------------------------------------------------------------*/
@@ -78,21 +99,34 @@ typedef struct {
 	EPTME_BLANK_SKIP_TYPE		paperReduction;				// Paper reduction settings.
 	EPTME_BUZZER				buzzerControl;				// Buzzer control settings.
 	EPTME_DRAWER				drawerControl;				// Drawer control settings.
+	EPTME_DRAWER_KICK			drawerKick;					// Drawer kick timing settings.
+	EPTME_SLIP_RELEASE			slipRelease;				// Slip data release settings.
 	
 	unsigned					maxBandLines;				// Maximum band length.
 } EPTMS_CONFIG_T;											// Configuration parameters
 
 typedef struct {
-	cups_raster_t*				p_raster;					
+	unsigned char*				p_data;						
+	unsigned long				size;						
+	unsigned long				capacity;					
+} EPTMS_SPOOL_T;											// Encoded page data
+
+typedef struct {
+	EPTMS_RASTER_STREAM_T*		p_stream;					
+	cups_raster_t*				p_raster;					// Other formats than EPTMS_RASTER_STREAM_T.
 	cups_page_header_t			pageHeader;					
 	
 	unsigned char*				p_pageBuffer;				
+	EPTMS_INK_LINES_T			inkLines;					
+	unsigned					page;						// Page number.
+	EPTMS_SPOOL_T				spool;						// Encoded page data.
 } EPTMS_JOB_INFO_T;											// Job Information parameters
 
 /*---------------------------------------------------------------------------------------------------------------------
  * Global variable declaration
  *-------------------------------------------------------------------------------------------------------------------*/
 char g_TmCanceled;
+EPTMS_SPOOL_T* g_TmSpool;	// WriteData() stores data here instead of writing it, if not NULL.
 
 /*---------------------------------------------------------------------------------------------------------------------
  * Static function prototype declaration
@@ -105,6 +139,8 @@ static int  GetParameters(char*[], EPTMS_CONFIG_T*);
 static int  GetModelSpecificFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
 static int  GetPaperReductionFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
 static int  GetBuzzerAndDrawerFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
+static int  GetDrawerKickFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
+static int  GetSlipReleaseFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
 static void Exit(EPTMS_JOB_INFO_T*, int*);
 
 static int  DoJob(EPTMS_CONFIG_T*, EPTMS_JOB_INFO_T*);
@@ -114,20 +150,26 @@ static int  SoundBuzzer(EPTMS_CONFIG_T*);
 static int  EndJob(EPTMS_CONFIG_T*, EPTMS_JOB_INFO_T*);
 
 static int  DoPage(EPTMS_CONFIG_T*, EPTMS_JOB_INFO_T*);
-static int  StartPage(EPTMS_CONFIG_T*);
+static int  StartPage(EPTMS_CONFIG_T*, unsigned);
+static int  WaitSlipInsertion(unsigned);
 static int  EndPage(EPTMS_CONFIG_T*, cups_page_header_t*);
 static int  ReadRaster(cups_page_header_t*, cups_raster_t*, unsigned char*);
 static void TransferRaster(unsigned char*, unsigned char*, cups_page_header_t*, unsigned);
-static int  WriteRaster(EPTMS_CONFIG_T*, cups_page_header_t*, unsigned char*);
+static int  WriteRaster(EPTMS_CONFIG_T*, cups_page_header_t*, unsigned char*, EPTMS_INK_LINES_T*);
 static void AvoidDisturbingData(cups_page_header_t*, unsigned char*, unsigned, unsigned);
 static unsigned FindBlackRasterLineTop(cups_page_header_t*, unsigned char*);
 static unsigned FindBlackRasterLineEnd(cups_page_header_t*, unsigned char*);
 static int  WriteBand(EPTMS_CONFIG_T* p_config, cups_page_header_t*, unsigned char*, unsigned);
 
+static unsigned ReadRasterHeader(EPTMS_JOB_INFO_T*);
+
 static int  WriteUserFile(char*, char*);
 static int  ReadUserFile(int, void*, int);
 static int  FeedPaper(EPTMS_CONFIG_T*, cups_page_header_t*, unsigned);
 static int  WriteData(unsigned char*, unsigned int);
+static int  SpoolData(unsigned char*, unsigned int);
+static int  FlushSpool(EPTMS_SPOOL_T*);
+static int  ReadBackChannel(unsigned char*, double);
 
 /*---------------------------------------------------------------------------------------------------------------------
  * Main function for process.
@@ -180,6 +222,8 @@ static void fprintf_DebugLog(EPTMS_CONFIG_T* p_config)
 	fprintf( stderr, "DEBUG:      paperReduction = %d\n",  p_config->paperReduction      );
 	fprintf( stderr, "DEBUG:       buzzerControl = %d\n",  p_config->buzzerControl       );
 	fprintf( stderr, "DEBUG:       drawerControl = %d\n",  p_config->drawerControl       );
+	fprintf( stderr, "DEBUG:          drawerKick = %d\n",  p_config->drawerKick          );
+	fprintf( stderr, "DEBUG:         slipRelease = %d\n",  p_config->slipRelease         );
 	fprintf( stderr, "DEBUG:        maxBandLines = %u\n",  p_config->maxBandLines        );
 }
 
@@ -214,10 +258,17 @@ static int Init(int argc, char *argv[], EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO
 		}
 		else {}
 		
-		p_jobInfo->p_raster = cupsRasterOpen( *p_InputFd, CUPS_RASTER_READ );
-		if ( NULL == p_jobInfo->p_raster ) {
+		p_jobInfo->p_stream = OpenRasterStream( *p_InputFd );
+		if ( NULL == p_jobInfo->p_stream ) {
 			return 1003;
 		}
+		
+		if ( 0 == p_jobInfo->p_stream->native ) { // Other formats are read by libcups.
+			p_jobInfo->p_raster = cupsRasterOpenIO( ReadStreamIO, p_jobInfo->p_stream, CUPS_RASTER_READ );
+			if ( NULL == p_jobInfo->p_raster ) {
+				return 1003;
+			}
+		}
 	}
 	
 	// Get parameters.
@@ -314,6 +365,12 @@ static int GetParameters(char *argv[], EPTMS_CONFIG_T *p_config)
 		if ( EPTMD_SUCCESS == result ) {
 			result = GetBuzzerAndDrawerFromPPD( p_ppd, p_config );
 		}
+		if ( EPTMD_SUCCESS == result ) {
+			result = GetDrawerKickFromPPD( p_ppd, p_config );
+		}
+		if ( EPTMD_SUCCESS == result ) {
+			result = GetSlipReleaseFromPPD( p_ppd, p_config );
+		}
 	}
 	// Unload the PPD file
 	ppdClose( p_ppd );
@@ -410,6 +467,54 @@ static int GetBuzzerAndDrawerFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config
 	return EPTMD_SUCCESS;
 }
 
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get drawer kick timing.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int GetDrawerKickFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config)
+{
+	char ppdKey[] = "TmxDrawerKick";
+	
+	ppd_choice_t* p_choice = ppdFindMarkedChoice( p_ppd, ppdKey );
+	if ( NULL == p_choice ) { // PPD files of older versions do not have this option.
+		p_config->drawerKick = TmDrawerKickQueued;
+		return EPTMD_SUCCESS;
+	}
+	
+	if ( 0 == strcmp( "Queued", p_choice->choice ) ) {
+		p_config->drawerKick = TmDrawerKickQueued;
+	}
+	else if ( 0 == strcmp( "RealTime", p_choice->choice ) ) {
+		p_config->drawerKick = TmDrawerKickRealTime;
+	}
+	else { return 4502; }
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get slip data release timing.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int GetSlipReleaseFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config)
+{
+	char ppdKey[] = "TmxSlipRelease";
+	
+	ppd_choice_t* p_choice = ppdFindMarkedChoice( p_ppd, ppdKey );
+	if ( NULL == p_choice ) { // PPD files of older versions do not have this option.
+		p_config->slipRelease = TmSlipReleaseImmediate;
+		return EPTMD_SUCCESS;
+	}
+	
+	if ( 0 == strcmp( "Immediate", p_choice->choice ) ) {
+		p_config->slipRelease = TmSlipReleaseImmediate;
+	}
+	else if ( 0 == strcmp( "OnInsertion", p_choice->choice ) ) {
+		p_config->slipRelease = TmSlipReleaseOnInsertion;
+	}
+	else { return 4602; }
+	
+	return EPTMD_SUCCESS;
+}
+
 /*---------------------------------------------------------------------------------------------------------------------
  * Finalizes process.
  *-------------------------------------------------------------------------------------------------------------------*/
@@ -420,6 +525,11 @@ static void Exit(EPTMS_JOB_INFO_T* p_jobInfo, int* p_InputFd)
 		p_jobInfo->p_raster = NULL;
 	}
 	
+	if ( NULL != p_jobInfo->p_stream ) {
+		free( p_jobInfo->p_stream );
+		p_jobInfo->p_stream = NULL;
+	}
+	
 	if ( 0 < *p_InputFd ) {
 		close( *p_InputFd );
 		*p_InputFd = -1;
@@ -438,12 +548,13 @@ static int DoJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 	
 	while ( EPTMD_SUCCESS == result )
 	{
-		if ( 0 == cupsRasterReadHeader( p_jobInfo->p_raster, &p_jobInfo->pageHeader ) ) {
+		if ( 0 == ReadRasterHeader( p_jobInfo ) ) {
 			result = EPTMD_SUCCESS;
 			break;
 		}
 		
 		page++;
+		p_jobInfo->page = page;
 		fprintf( stderr, "PAGE: %u %d\n"                 , page, p_jobInfo->pageHeader.NumCopies  );
 		fprintf( stderr, "DEBUG: cupsBytesPerLine = %u\n", p_jobInfo->pageHeader.cupsBytesPerLine );
 		fprintf( stderr, "DEBUG: cupsBitsPerPixel = %u\n", p_jobInfo->pageHeader.cupsBitsPerPixel );
@@ -475,6 +586,13 @@ static int DoJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 		p_jobInfo->p_pageBuffer = NULL;
 	}
 	
+	// Free buffer of encoded page.
+	g_TmSpool = NULL;
+	if ( NULL != p_jobInfo->spool.p_data ) {
+		free( p_jobInfo->spool.p_data );
+		p_jobInfo->spool.p_data = NULL;
+	}
+	
 	if ( EPTMD_SUCCESS != result ) {
 		EndJob( p_config, p_jobInfo );
 	}
@@ -496,6 +614,12 @@ static int StartJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 		return EPTMD_CANCEL;
 	}
 	
+	// Drawer open. (A real-time command does not wait for the data in the receive buffer.)
+	if ( TmDrawerKickRealTime == p_config->drawerKick ) {
+		result = OpenDrawer( p_config );
+		if ( EPTMD_SUCCESS != result ) { return 2106; }
+	}
+	
 	{ // Write configuration commands.
 		unsigned char CommandSetDevice[3+2] = { ESC, '=', 0x01, ESC, '@' };
 		result = WriteData( CommandSetDevice, sizeof(CommandSetDevice) );
@@ -519,8 +643,10 @@ static int StartJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 	}
 	
 	// Drawer open.
-	result = OpenDrawer( p_config );
-	if ( EPTMD_SUCCESS != result ) { return 2106; }
+	if ( TmDrawerKickQueued == p_config->drawerKick ) {
+		result = OpenDrawer( p_config );
+		if ( EPTMD_SUCCESS != result ) { return 2106; }
+	}
 	
 	// Sound buzzer.
 	result = SoundBuzzer( p_config );
@@ -544,10 +670,18 @@ static int OpenDrawer(EPTMS_CONFIG_T* p_config)
 		return EPTMD_SUCCESS;
 	}
 	
-	unsigned char Command[5] = { ESC, 'p', 0, 50 /* on time */, 200 /* off time */ };
-	Command[2] = p_config->drawerControl - 1; // pin no
-	
-	result = WriteData( Command, sizeof(Command) );
+	if ( TmDrawerKickRealTime == p_config->drawerKick ) {
+		unsigned char Command[5] = { DLE, 0x14, 1, 0, 1 /* pulse time (x 100 ms) */ };
+		Command[3] = p_config->drawerControl - 1; // pin no
+		
+		result = WriteData( Command, sizeof(Command) );
+	}
+	else {
+		unsigned char Command[5] = { ESC, 'p', 0, 50 /* on time */, 200 /* off time */ };
+		Command[2] = p_config->drawerControl - 1; // pin no
+		
+		result = WriteData( Command, sizeof(Command) );
+	}
 	
 	return result;
 }
@@ -606,14 +740,40 @@ static int DoPage(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 {
 	int result;
 	
-	result = StartPage( p_config );
+	// The printer waits for the slip from here, while the page is read and encoded.
+	result = StartPage( p_config, p_jobInfo->page );
+	
+	if ( EPTMD_SUCCESS == result ) {
+		if ( NULL != p_jobInfo->p_raster ) {
+			p_jobInfo->inkLines.known = 0;
+			result = ReadRaster( &p_jobInfo->pageHeader, p_jobInfo->p_raster, p_jobInfo->p_pageBuffer );
+		}
+		else {
+			result = DecodeRaster( &p_jobInfo->pageHeader, p_jobInfo->p_stream, p_jobInfo->p_pageBuffer, p_jobInfo->pageHeader.cupsBytesPerLine, &p_jobInfo->inkLines );
+			if ( EPTMD_FAILED == result ) { result = 3303; }
+		}
+	}
 	
 	if ( EPTMD_SUCCESS == result ) {
-		result = ReadRaster( &p_jobInfo->pageHeader, p_jobInfo->p_raster, p_jobInfo->p_pageBuffer );
+		p_jobInfo->spool.size = 0;
+		g_TmSpool = &p_jobInfo->spool;
+		
+		result = WriteRaster( p_config, &p_jobInfo->pageHeader, p_jobInfo->p_pageBuffer, &p_jobInfo->inkLines );
+		
+		g_TmSpool = NULL;
+	}
+	
+	if ( (EPTMD_SUCCESS == result) && (TmSlipReleaseOnInsertion == p_config->slipRelease) ) {
+		result = WaitSlipInsertion( p_jobInfo->page );
+		if ( EPTMD_FAILED == result ) { // The printer still waits for the slip. The backend may not relay the response,
+			fprintf( stderr, "DEBUG: Slip insertion is not answered. Pages are sent without waiting.\n" );
+			p_config->slipRelease = TmSlipReleaseImmediate;	// so the other pages are not held either.
+			result = EPTMD_SUCCESS;
+		}
 	}
 	
 	if ( EPTMD_SUCCESS == result ) {
-		result = WriteRaster( p_config, &p_jobInfo->pageHeader, p_jobInfo->p_pageBuffer );
+		result = FlushSpool( &p_jobInfo->spool );
 	}
 	
 	if ( EPTMD_SUCCESS == result ) {
@@ -626,7 +786,7 @@ static int DoPage(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 /*---------------------------------------------------------------------------------------------------------------------
  * Start page.
  *-------------------------------------------------------------------------------------------------------------------*/
-static int StartPage(EPTMS_CONFIG_T* p_config)
+static int StartPage(EPTMS_CONFIG_T* p_config, unsigned page)
 {
 	int result;
 	
@@ -635,6 +795,22 @@ static int StartPage(EPTMS_CONFIG_T* p_config)
 	result = WriteData( CommandFeedToThePrintStartingPosition, sizeof(CommandFeedToThePrintStartingPosition) );
 	if ( EPTMD_SUCCESS != result ) { return 3101; }
 	
+	// Request a process ID response. (The printer answers when the slip has been inserted.)
+	if ( TmSlipReleaseOnInsertion == p_config->slipRelease ) {
+		// Discard responses left by an earlier job.
+		unsigned char data = 0;
+		while ( 0 < ReadBackChannel( &data, 0.0 ) ) {}
+		
+		// d1 to d4 must be "0" to "9". (The page number wraps after 9999. Older responses are discarded above.)
+		unsigned char CommandRequestProcessId[11] = { GS, '(', 'H', 6, 0, 48, 48, 0, 0, 0, 0 };
+		CommandRequestProcessId[7]  = (unsigned char)('0' + ((page / 1000) % 10));
+		CommandRequestProcessId[8]  = (unsigned char)('0' + ((page / 100 ) % 10));
+		CommandRequestProcessId[9]  = (unsigned char)('0' + ((page / 10  ) % 10));
+		CommandRequestProcessId[10] = (unsigned char)('0' + ((page       ) % 10));
+		result = WriteData( CommandRequestProcessId, sizeof(CommandRequestProcessId) );
+		if ( EPTMD_SUCCESS != result ) { return 3103; }
+	}
+	
 	// Send user file.
 	result = WriteUserFile( p_config->p_printerName, "StartPage.prn" );
 	if ( EPTMD_SUCCESS != result ) { return 3102; }
@@ -642,6 +818,50 @@ static int StartPage(EPTMS_CONFIG_T* p_config)
 	return EPTMD_SUCCESS;
 }
 
+/*---------------------------------------------------------------------------------------------------------------------
+ * Wait for slip insertion.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int WaitSlipInsertion(unsigned page)
+{
+	// Process ID response : 37h 22h d1 d2 d3 d4 00h
+	unsigned char Response[7] = { 0x37, 0x22, 0, 0, 0, 0, 0x00 };
+	Response[2] = (unsigned char)('0' + ((page / 1000) % 10));
+	Response[3] = (unsigned char)('0' + ((page / 100 ) % 10));
+	Response[4] = (unsigned char)('0' + ((page / 10  ) % 10));
+	Response[5] = (unsigned char)('0' + ((page       ) % 10));
+	
+	time_t   start   = time( NULL );
+	unsigned matched = 0;
+	while ( sizeof(Response) > matched )
+	{
+		if ( 0 != g_TmCanceled ) {
+			return EPTMD_CANCEL;
+		}
+		if ( EPTMD_INSERTION_TIMEOUT <= (time( NULL ) - start) ) { // No response
+			return EPTMD_FAILED;
+		}
+		
+		unsigned char data = 0;
+		int size = ReadBackChannel( &data, 1.0 );
+		if ( 0 > size ) { // No backchannel
+			break;
+		}
+		else if ( 0 == size ) {
+			continue;
+		}
+		else {}
+		
+		if ( Response[matched] == data ) {
+			matched++;
+		}
+		else {
+			matched = (Response[0] == data) ? 1 : 0;
+		}
+	}
+	
+	return EPTMD_SUCCESS;
+}
+
 /*---------------------------------------------------------------------------------------------------------------------
  * End page.
  *-------------------------------------------------------------------------------------------------------------------*/
@@ -712,10 +932,22 @@ static void TransferRaster(unsigned char* p_pageBuffer, unsigned char *p_data, c
 	memcpy( p_dest, p_data, p_header->cupsBytesPerLine );
 }
 
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read page header.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static unsigned ReadRasterHeader(EPTMS_JOB_INFO_T* p_jobInfo)
+{
+	if ( NULL != p_jobInfo->p_raster ) {
+		return cupsRasterReadHeader( p_jobInfo->p_raster, &p_jobInfo->pageHeader );
+	}
+	
+	return ReadStreamHeader( p_jobInfo->p_stream, &p_jobInfo->pageHeader );
+}
+
 /*---------------------------------------------------------------------------------------------------------------------
  * Write raster data of one page.
  *-------------------------------------------------------------------------------------------------------------------*/
-static int WriteRaster(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, unsigned char* p_pageBuffer)
+static int WriteRaster(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, unsigned char* p_pageBuffer, EPTMS_INK_LINES_T* p_inkLines)
 {
 	unsigned 		line_no = 0;
 	unsigned 		start_line_no = 0;	/* first raster line without top blank */
@@ -723,8 +955,13 @@ static int WriteRaster(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, u
 	unsigned char*	p_data = NULL;
 	int				result = EPTMD_SUCCESS;
 	
-	// Get top margin
-	start_line_no = FindBlackRasterLineTop( p_header, p_pageBuffer );
+	// Get top margin (Already known if the page was decoded by the filter.)
+	if ( 0 != p_inkLines->known ) {
+		start_line_no = p_inkLines->top;
+	}
+	else {
+		start_line_no = FindBlackRasterLineTop( p_header, p_pageBuffer );
+	}
 	if( p_header->cupsHeight == start_line_no ) { /* This page has not image */
 		if ( TmPaperReductionOff == p_config->paperReduction ) {
 			result = FeedPaper( p_config, p_header, p_header->cupsHeight );
@@ -734,7 +971,12 @@ static int WriteRaster(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, u
 	}
 	
 	// Get bottom margin
-	last_line_no = FindBlackRasterLineEnd( p_header, p_pageBuffer ) + 1;
+	if ( 0 != p_inkLines->known ) {
+		last_line_no = p_inkLines->end;
+	}
+	else {
+		last_line_no = FindBlackRasterLineEnd( p_header, p_pageBuffer ) + 1;
+	}
 	
 	// Command output : top margin
 	if ( !((TmPaperReductionTop == p_config->paperReduction) || (TmPaperReductionBoth == p_config->paperReduction)) ) {
@@ -774,7 +1016,7 @@ static void AvoidDisturbingData(cups_page_header_t* p_header, unsigned char* p_p
 	unsigned char*	p_data = p_pageBuffer + (p_header->cupsBytesPerLine * start_line_no);
 	unsigned long	data_size = (last_line_no - start_line_no) * p_header->cupsBytesPerLine;
 	
-	unsigned long i;
+	unsigned long i = 0;
 	for ( ; (i + 1) < data_size; i++ ) {
 		if ( 0x10 == p_data[i] ) {
 			if ( (0x04 == p_data[i+1]) || (0x05 == p_data[i+1]) || (0x14 == p_data[i+1]) ) {
@@ -1011,6 +1253,10 @@ static int WriteData(unsigned char *p_buffer, unsigned int size)
 	char*	p_data = (char*)p_buffer;
 	int		result = 0;
 	
+	if ( NULL != g_TmSpool ) {
+		return SpoolData( p_buffer, size );
+	}
+	
 	unsigned int count;
 	for ( count = 0; size > count; count += result ) {
 		result = (int)write( STDOUT_FILENO, (p_data + count), (size - count) );
@@ -1028,4 +1274,58 @@ static int WriteData(unsigned char *p_buffer, unsigned int size)
 	
 	return (count == size) ? EPTMD_SUCCESS : EPTMD_FAILED;
 }
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Store data to the encoded page buffer.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int SpoolData(unsigned char *p_buffer, unsigned int size)
+{
+	if ( g_TmSpool->capacity < (g_TmSpool->size + size) ) {
+		unsigned long capacity = (0 == g_TmSpool->capacity) ? (64 * 1024) : g_TmSpool->capacity;
+		while ( capacity < (g_TmSpool->size + size) ) {
+			capacity *= 2;
+		}
+		
+		unsigned char* p_data = (unsigned char*)realloc( g_TmSpool->p_data, capacity );
+		if ( NULL == p_data ) {
+			return EPTMD_FAILED;
+		}
+		g_TmSpool->p_data   = p_data;
+		g_TmSpool->capacity = capacity;
+	}
+	
+	memcpy( g_TmSpool->p_data + g_TmSpool->size, p_buffer, size );
+	g_TmSpool->size += size;
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Write the encoded page buffer to file descriptor.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int FlushSpool(EPTMS_SPOOL_T* p_spool)
+{
+	int result = EPTMD_SUCCESS;
+	
+	if ( 0 < p_spool->size ) {
+		result = WriteData( p_spool->p_data, (unsigned int)p_spool->size );
+		if ( EPTMD_SUCCESS != result ) { return 3501; }
+	}
+	p_spool->size = 0;
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read one byte from the backchannel.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int ReadBackChannel(unsigned char* p_data, double timeout)
+{
+	ssize_t size = cupsBackChannelRead( (char*)p_data, 1, timeout );
+	if ( 0 == size ) { // End of file : the backend has no backchannel.
+		return EPTMD_FAILED;
+	}
+	
+	return (1 == size) ? 1 : 0;
+}
 /*-------------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,20 @@
+#!/bin/sh
+# Builds the filter against the libcups stub of the receipt filter tests and runs the scripted printer tests.
+#   run_tests.sh [build directory]
+
+TESTDIR=$(cd "$(dirname "$0")" && pwd)
+BUILDDIR=${1:-$TESTDIR/build}
+SHAREDDIR="$TESTDIR/../../Thermal Receipt/test"
+CC=${CC:-cc}
+
+mkdir -p "$BUILDDIR/data" || exit 1
+BUILDDIR=$(cd "$BUILDDIR" && pwd)
+
+# A page waits 2 s for the slip instead of 300 s.
+$CC -std=gnu99 -O2 -Wall -I"$SHAREDDIR/stub" -I"$TESTDIR/../../Common/filter" \
+    -DEPTMD_DATA_DIR="\"$BUILDDIR/data\"" -DEPTMD_INSERTION_TIMEOUT=2 \
+    -o "$BUILDDIR/rastertotmis" "$TESTDIR/../filter/TmImpactSlip.c" "$TESTDIR/../../Common/filter/TmRasterStream.c" \
+    "$SHAREDDIR/stub/libcups.c" -lm || exit 1
+
+cd "$TESTDIR" && TMX_BUILD_DIR="$BUILDDIR" TMX_FILTER=rastertotmis PYTHONPATH="$SHAREDDIR" \
+    python3 -m unittest discover -s "$TESTDIR" -p 'test_*.py' -v
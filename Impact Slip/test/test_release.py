@@ -0,0 +1,74 @@
+"""Releasing encoded slip pages when the slip is inserted (TmxSlipRelease).
+
+The printer answers GS ( H after the slip is inserted and fed to the print start position (GS ( G <Function 84>).
+The fake printer models the operator with a stall after that command. The filter is built with
+EPTMD_INSERTION_TIMEOUT=2, so an unanswered page is sent after 2 s.
+"""
+
+import os
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+PPD = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'ppd', 'tm-impact-slip-rastertotmis.ppd')
+WIDTH = 640
+GS_G_FEED = b'\x1d(G\x02\x00\x54'
+ESC_STAR = b'\x1b*'
+ON_INSERTION = 'TmxSlipRelease=OnInsertion'
+
+
+def slip(pages):
+    return tmx.raster([(WIDTH, tmx.text(WIDTH, 200, seed=page + 1)) for page in range(pages)], resolution=160)
+
+
+def released(printer):
+    """Seconds at which the first graphics data of each page arrived."""
+    times, page = [], 0
+    for seconds, command in printer.received:
+        if tmx.is_command(command, GS_G_FEED):
+            page += 1
+        elif tmx.is_command(command, ESC_STAR) and len(times) < page:
+            times.append(seconds)
+    return times
+
+
+class SlipReleaseTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+
+    def test_immediate_is_the_default(self):
+        printer = FakePrinter(stall={GS_G_FEED: 1.0})
+        result = printer.run(slip(1), '', PPD)
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(result.find(tmx.GS_H_ID), [])
+        self.assertLess(released(printer)[0], 0.5)
+
+    def test_page_is_released_on_insertion(self):
+        printer = FakePrinter(stall={GS_G_FEED: 1.0})
+        result = printer.run(slip(2), ON_INSERTION, PPD)
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual([command[7:11] for command in result.find(tmx.GS_H_ID)], [b'0001', b'0002'])
+        first, second = released(printer)
+        self.assertGreaterEqual(first, 1.0)
+        self.assertGreaterEqual(second, 2.0)
+
+    def test_unanswered_page_is_sent(self):
+        printer = FakePrinter(mute=True)
+        result = printer.run(slip(2), ON_INSERTION, PPD)
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertIn('Slip insertion is not answered', result.log)
+        self.assertEqual(len(released(printer)), 2)
+        self.assertEqual(len(result.find(tmx.GS_H_ID)), 1)         # The other pages are not held.
+        self.assertLess(result.elapsed, 4.0)
+
+    def test_no_backchannel(self):
+        printer = FakePrinter(backchannel=False)
+        result = printer.run(slip(2), ON_INSERTION, PPD)
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(len(released(printer)), 2)
+        self.assertLess(result.elapsed, 1.0)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -27,9 +27,13 @@
 #include <unistd.h>
 #include <string.h>
 #include <math.h>
+#include <poll.h>
+#include <time.h>
 #include <stdlib.h>
 #include <limits.h> // LONG_MAX
 
+#include "TmRasterStream.h"
+
 /*---------------------------------------------------------------------------------------------------------------------
  * Result code
  *-------------------------------------------------------------------------------------------------------------------*/
@@ -40,9 +44,71 @@
 /*---------------------------------------------------------------------------------------------------------------------
  * command declaration
  *-------------------------------------------------------------------------------------------------------------------*/
+#define DLE (0x10)
 #define ESC (0x1b)
 #define GS  (0x1d)
 
+/*---------------------------------------------------------------------------------------------------------------------
+ * Data directory (user files, printer cache)
+ *-------------------------------------------------------------------------------------------------------------------*/
+#ifndef EPTMD_DATA_DIR
+#ifndef EPD_TM_MAC
+#define EPTMD_DATA_DIR "/var/lib/tmx-cups"
+#else
+#define EPTMD_DATA_DIR "/Library/Caches/Epson/TerminalPrinter"
+#endif
+#endif
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Band size
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_BAND_LINES         (256)	// Maximum band length. (Shortened to fit the download graphics memory of the printer)
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Capability probe
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_PROBE_TIMEOUT      (2.0)	// Seconds to wait for each response on the backchannel.
+#define EPTMD_DRAIN_TIMEOUT      (0.5)	// Seconds without data that end discarding late responses.
+#define EPTMD_PROBE_INTERVAL     (600)	// Seconds before a printer that did not answer is probed again.
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Printer state
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_STATE_LIFETIME     (60)	// Seconds the printer is assumed to keep the settings of the previous job.
+#define EPTMD_STATUS_COUNT       (4)	// DLE EOT <n = 1 to 4>
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Reserved cut
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_NEXT_JOB_TIMEOUT   (3.0)		// Seconds to wait for a job being received before cutting immediately.
+#define EPTMD_NEXT_JOB_INTERVAL  (250000)	// Microseconds between job queue checks.
+#ifndef EPTMD_RESERVED_CUT_TIMEOUT
+#define EPTMD_RESERVED_CUT_TIMEOUT (10)		// Seconds for the next job to start before the cut is sent as a job of its own.
+#endif
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Checkpoint (resume after output failure)
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_MAX_CHECKPOINT     (9999)	// GS ( H <Function 48> : Process ID is sent as 4 decimal digits.
+#define EPTMD_PROCESS_ID_SIZE    (7)	// Process ID response : 37h 22h d1 d2 d3 d4 00h
+#define EPTMD_CHECKPOINT_TIMEOUT (1.0)	// Seconds to wait in total for the process ID responses at the end of a page.
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Solid fill thinning and print speed
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_THINNING_DENSITY   (25)	// Bands denser than this (%) are thinned.
+#define EPTMD_PRINT_SPEED_CUSTOM (0)	// GS ( K <Function 50> : customized value
+#define EPTMD_PRINT_SPEED_LIMIT  (13)	// GS ( K <Function 50> : highest speed level of the specification
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Progress report
+ *-------------------------------------------------------------------------------------------------------------------*/
+#define EPTMD_PROGRESS_INTERVAL  (1.0)	// Minimum seconds between progress reports.
+#ifndef EPTMD_STALL_TIMEOUT
+#define EPTMD_STALL_TIMEOUT      (10)	// Seconds WriteData may be blocked before a stall warning.
+#endif
+#define EPTMD_WRITE_CHUNK        (4096)	// Maximum bytes per write(). (Stall check interval)
+
 /*---------------------------------------------------------------------------------------------------------------------
  * MACRO (#define)
  *-------------------------------------------------------------------------------------------------------------------*/
@@ -70,40 +136,129 @@ typedef enum {
 	TmDrawer2,
 } EPTME_DRAWER;												// Drawer No
 
+typedef enum {
+	TmDrawerKickQueued = 0,
+	TmDrawerKickRealTime,
+} EPTME_DRAWER_KICK;										// Drawer Kick Timing
+
 typedef enum {
 	TmNoCut = 0,
 	TmCutPerJob,
 	TmCutPerPage,
 } EPTME_PAPER_CUT;											// Paper Cut
 
+typedef enum {
+	TmCutImmediate = 0,										// Feed to the cutter and cut. (GS V <Function B>)
+	TmCutReserved,											// Cut when the next data feeds the paper. (GS V <Function C>)
+} EPTME_CUT_MODE;											// Paper Cut Timing
+
+typedef enum {
+	TmResumeOff = 0,										// Print the whole job again.
+	TmResumeBand,											// Resume from the first band not printed.
+} EPTME_RESUME;												// Resume After Interruption
+
+typedef enum {
+	TmSolidThinningOff = 0,
+	TmSolidThinningCheckerboard,
+	TmSolidThinningEdgePreserving,
+} EPTME_SOLID_THINNING;										// Solid Fill Thinning
+
+typedef enum {
+	TmRealTimeCommandPatch = 0,								// Alter image bytes that look like real-time commands.
+	TmRealTimeCommandDisable,								// Disable real-time commands during graphics. (GS ( D)
+} EPTME_REAL_TIME_COMMAND;									// Real-time command handling in graphics
+
+typedef enum {
+	TmGraphicsRaster = 0,									// GS 8 L <Function 112> + GS ( L <Function 50>
+	TmGraphicsBitImage,										// GS v 0
+} EPTME_GRAPHICS_COMMAND;									// Graphics command
+
 /*---------------------------------------------------------------------------------------------------------------------
  * Stracture prototype declaration
  *-------------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+	int							probed;						// Read from the printer (or its cache file).
+	unsigned					modelId;					// GS I 1
+	char						modelName[64];				// GS I 67
+	unsigned long				bufferCapacity;				// Remaining download graphics memory. (Limits the band size)
+	EPTME_GRAPHICS_COMMAND		graphicsCommand;			// Graphics command used for bands.
+	long						time;						// Time the printer did not answer. (time_t)
+} EPTMS_CAPABILITY_T;										// Printer capabilities
+
+typedef struct {
+	int							initialized;				// ESC @ and the sensor settings were sent.
+	unsigned					h_motionUnit;				// GS P
+	unsigned					v_motionUnit;				// GS P
+	unsigned char				status[EPTMD_STATUS_COUNT];	// DLE EOT <n = 1 to 4>
+	int							cutReserved;				// The last cut is reserved. (GS V <Function C>)
+	long						time;						// Time the job ended. (time_t)
+} EPTMS_PRINTER_STATE_T;									// Printer state left by the previous job
+
+typedef struct {
+	int							enabled;					// Process IDs are sent after bands. (GS ( H <Function 48>)
+	unsigned					sequence;					// Checkpoints passed in this job.
+	unsigned					printed;					// Last checkpoint printed. (Process ID response)
+	unsigned					resumed;					// Last checkpoint printed by the interrupted run of this job.
+	unsigned char				response[EPTMD_PROCESS_ID_SIZE];	// Process ID response being received.
+	unsigned					responseSize;
+} EPTMS_CHECKPOINT_T;										// Printed position of the job
+
 typedef struct {
 	char*						p_printerName;				// The name of the destination printer.
 	
 	unsigned					h_motionUnit;				// Horizontal motion units.
 	unsigned					v_motionUnit;				// Vertical motion units.
+	unsigned					maxPrintSpeed;				// Highest print speed level of the model. (0 : unknown)
+	int							realTimeSwitch;				// The model can disable real-time commands. (GS ( D)
 	
 	EPTME_BLANK_SKIP_TYPE		paperReduction;				// Paper reduction settings.
 	EPTME_BUZZER				buzzerControl;				// Buzzer control settings.
 	EPTME_DRAWER				drawerControl;				// Drawer control settings.
+	EPTME_DRAWER_KICK			drawerKick;					// Drawer kick timing settings.
 	EPTME_PAPER_CUT				cutControl;					// Paper cut settings.
+	EPTME_CUT_MODE				cutMode;					// Paper cut timing settings.
+	EPTME_SOLID_THINNING		solidThinning;				// Solid fill thinning settings.
+	EPTME_REAL_TIME_COMMAND		realTimeCommand;			// Real-time command handling settings.
+	EPTME_RESUME				resume;						// Resume settings.
 	
 	unsigned					maxBandLines;				// Maximum band length.
+	unsigned					printSpeed;					// Current print speed level. (GS ( K <Function 50>)
+	unsigned					h_magnification;			// Horizontal magnification of the page. (1 or 2)
+	unsigned					v_magnification;			// Vertical magnification of the page. (1 or 2)
+	int							realTimeDisabled;			// Real-time commands are disabled. (GS ( D)
+	int							cutPending;					// A cut is due at the current position.
+	int							jobId;						// The job ID.
+	
+	EPTMS_CAPABILITY_T			capability;					// Printer capabilities.
+	EPTMS_PRINTER_STATE_T		state;						// Printer state.
+	EPTMS_CHECKPOINT_T			checkpoint;					// Printed position.
 } EPTMS_CONFIG_T;											// Configuration parameters
 
 typedef struct {
-	cups_raster_t*				p_raster;					
+	unsigned					page;						// Page number.
+	unsigned					pageLines;					// Raster lines to send on this page.
+	unsigned					sentLines;					// Raster lines sent on this page.
+	unsigned					bands;						// Bands sent on this page.
+	unsigned long				bytes;						// Bytes sent in this job.
+	double						startTime;					// Time the job started. (seconds)
+	double						reportTime;					// Time of the last report. (seconds)
+	int							stalled;					// WriteData is blocked.
+} EPTMS_PROGRESS_T;											// Progress of the job
+
+typedef struct {
+	EPTMS_RASTER_STREAM_T*		p_stream;					
+	cups_raster_t*				p_raster;					// Other formats than EPTMS_RASTER_STREAM_T.
 	cups_page_header_t			pageHeader;					
 	
 	unsigned char*				p_pageBuffer;				
+	EPTMS_INK_LINES_T			inkLines;					
 } EPTMS_JOB_INFO_T;											// Job Information parameters
 
 /*---------------------------------------------------------------------------------------------------------------------
  * Global variable declaration
  *-------------------------------------------------------------------------------------------------------------------*/
 char g_TmCanceled;
+EPTMS_PROGRESS_T g_TmProgress;
 
 /*---------------------------------------------------------------------------------------------------------------------
  * Static function prototype declaration
@@ -116,7 +271,12 @@ static int  GetParameters(char*[], EPTMS_CONFIG_T*);
 static int  GetModelSpecificFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
 static int  GetPaperReductionFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
 static int  GetBuzzerAndDrawerFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
+static int  GetDrawerKickFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
 static int  GetPaperCutFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
+static int  GetSolidThinningFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
+static int  GetRealTimeCommandFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
+static int  GetCutModeFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
+static int  GetResumeFromPPD(ppd_file_t*, EPTMS_CONFIG_T*);
 static void Exit(EPTMS_JOB_INFO_T*, int*);
 
 static int  DoJob(EPTMS_CONFIG_T*, EPTMS_JOB_INFO_T*);
@@ -124,22 +284,72 @@ static int  StartJob(EPTMS_CONFIG_T*, EPTMS_JOB_INFO_T*);
 static int  OpenDrawer(EPTMS_CONFIG_T*);
 static int  SoundBuzzer(EPTMS_CONFIG_T*);
 static int  EndJob(EPTMS_CONFIG_T*, EPTMS_JOB_INFO_T*, cups_page_header_t*);
+static int  ReserveCut(void);
+static int  WaitNextJob(EPTMS_CONFIG_T*);
+static int  HasOtherJob(EPTMS_CONFIG_T*, ipp_jstate_t);
+static int  WatchReservedCut(EPTMS_CONFIG_T*);
+static int  SubmitCut(char*);
+static int  SaveState(EPTMS_CONFIG_T*);
 
 static int  DoPage(EPTMS_CONFIG_T*, EPTMS_JOB_INFO_T*);
 static int  StartPage(EPTMS_CONFIG_T*);
 static int  EndPage(EPTMS_CONFIG_T*, cups_page_header_t*);
 static int  ReadRaster(cups_page_header_t*, cups_raster_t*, unsigned char*);
 static void TransferRaster(unsigned char*, unsigned char*, cups_page_header_t*, unsigned);
-static int  WriteRaster(EPTMS_CONFIG_T*, cups_page_header_t*, unsigned char*);
-static void AvoidDisturbingData(cups_page_header_t*, unsigned char*, unsigned, unsigned);
+static int  WriteRaster(EPTMS_CONFIG_T*, cups_page_header_t*, unsigned char*, EPTMS_INK_LINES_T*);
+static void AvoidDisturbingData(unsigned char*, unsigned long, int);
+static int  WriteBands(EPTMS_CONFIG_T*, cups_page_header_t*, unsigned char*, unsigned, unsigned);
+static unsigned GetBandLines(EPTMS_CONFIG_T*, unsigned);
+static unsigned long ThinSolidFill(EPTMS_CONFIG_T*, cups_page_header_t*, unsigned char*, unsigned, unsigned, int, unsigned char*, unsigned, unsigned);
+static unsigned long CountDots(unsigned char*, unsigned long);
+static int  SelectPrintSpeed(EPTMS_CONFIG_T*, unsigned);
+static int  CanDisableRealTimeCommand(EPTMS_CONFIG_T*);
+static int  EnableRealTimeCommand(EPTMS_CONFIG_T*, int);
 static unsigned FindBlackRasterLineTop(cups_page_header_t*, unsigned char*);
 static unsigned FindBlackRasterLineEnd(cups_page_header_t*, unsigned char*);
-static int  WriteBand(cups_page_header_t*, unsigned char*, unsigned);
+static int  WriteBand(EPTMS_CONFIG_T*, cups_page_header_t*, unsigned char*, unsigned, unsigned, unsigned);
+static int  WriteRasterGraphics(unsigned long, unsigned char*, unsigned, unsigned, unsigned);
+static int  WriteBitImage(unsigned long, unsigned char*, unsigned, unsigned, unsigned);
+static void FindMagnification(unsigned char*, unsigned, unsigned, unsigned*, unsigned*);
+static void ShrinkBand(unsigned char*, unsigned, unsigned, unsigned char*, unsigned, unsigned);
+static unsigned GetMagnification(unsigned, unsigned);
+
+static unsigned ReadRasterHeader(EPTMS_JOB_INFO_T*);
+
+static int  GetCapability(EPTMS_CONFIG_T*);
+static int  ProbeCapability(EPTMS_CAPABILITY_T*);
+static int  ReadCapabilityFile(char*, EPTMS_CAPABILITY_T*);
+static int  WriteCapabilityFile(char*, EPTMS_CAPABILITY_T*);
+static int  ReadResponse(unsigned char, unsigned char*, int);
+static int  ReadBackChannel(unsigned char*, double);
+static void DrainBackChannel(double);
+
+static int  InitPrinter(EPTMS_CONFIG_T*);
+static int  GetPrinterStatus(unsigned char*);
+static int  IsPrinterStatus(unsigned char*);
+static int  HasUserFile(char*);
+static int  ReadStateFile(char*, EPTMS_PRINTER_STATE_T*);
+static int  WriteStateFile(char*, EPTMS_PRINTER_STATE_T*);
+static void RemoveStateFile(char*);
+
+static void ResumeJob(EPTMS_CONFIG_T*);
+static int  ClearBuffer(EPTMS_CONFIG_T*, int*);
+static int  CanTrackCheckpoint(EPTMS_CONFIG_T*);
+static int  IsPrinted(EPTMS_CONFIG_T*);
+static int  PassCheckpoint(EPTMS_CONFIG_T*);
+static void ReadCheckpoint(EPTMS_CONFIG_T*, double);
+static int  ReadCheckpointFile(char*, int*, unsigned*, unsigned*);
+static int  WriteCheckpointFile(char*, int, unsigned, unsigned);
+static void RemoveCheckpointFile(char*);
 
 static int  WriteUserFile(char*, char*);
 static int  ReadUserFile(int, void*, int);
 static int  FeedPaper(EPTMS_CONFIG_T*, cups_page_header_t*, unsigned);
 static int  WriteData(unsigned char*, unsigned int);
+static int  WaitWritable(void);
+static void StartProgress(unsigned, unsigned);
+static void ReportProgress(unsigned, int);
+static double GetTime(void);
 
 /*---------------------------------------------------------------------------------------------------------------------
  * Main function for process.
@@ -189,11 +399,25 @@ static void fprintf_DebugLog(EPTMS_CONFIG_T* p_config)
 	fprintf( stderr, "DEBUG:       p_printerName = %s\n",  p_config->p_printerName       );
 	fprintf( stderr, "DEBUG:        v_motionUnit = %u\n",  p_config->v_motionUnit        );
 	fprintf( stderr, "DEBUG:        h_motionUnit = %u\n",  p_config->h_motionUnit        );
+	fprintf( stderr, "DEBUG:       maxPrintSpeed = %u\n",  p_config->maxPrintSpeed       );
+	fprintf( stderr, "DEBUG:      realTimeSwitch = %d\n",  p_config->realTimeSwitch      );
 	fprintf( stderr, "DEBUG:      paperReduction = %d\n",  p_config->paperReduction      );
 	fprintf( stderr, "DEBUG:       buzzerControl = %d\n",  p_config->buzzerControl       );
 	fprintf( stderr, "DEBUG:       drawerControl = %d\n",  p_config->drawerControl       );
+	fprintf( stderr, "DEBUG:          drawerKick = %d\n",  p_config->drawerKick          );
 	fprintf( stderr, "DEBUG:          cutControl = %d\n",  p_config->cutControl          );
+	fprintf( stderr, "DEBUG:             cutMode = %d\n",  p_config->cutMode             );
+	fprintf( stderr, "DEBUG:       solidThinning = %d\n",  p_config->solidThinning       );
+	fprintf( stderr, "DEBUG:     realTimeCommand = %d\n",  p_config->realTimeCommand     );
+	fprintf( stderr, "DEBUG:              resume = %d\n",  p_config->resume              );
 	fprintf( stderr, "DEBUG:        maxBandLines = %u\n",  p_config->maxBandLines        );
+	fprintf( stderr, "DEBUG:     h_magnification = %u\n",  p_config->h_magnification     );
+	fprintf( stderr, "DEBUG:     v_magnification = %u\n",  p_config->v_magnification     );
+	fprintf( stderr, "DEBUG:              probed = %d\n",  p_config->capability.probed          );
+	fprintf( stderr, "DEBUG:             modelId = %u\n",  p_config->capability.modelId         );
+	fprintf( stderr, "DEBUG:           modelName = %s\n",  p_config->capability.modelName       );
+	fprintf( stderr, "DEBUG:      bufferCapacity = %lu\n", p_config->capability.bufferCapacity  );
+	fprintf( stderr, "DEBUG:     graphicsCommand = %d\n",  p_config->capability.graphicsCommand );
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
@@ -205,6 +429,8 @@ static int Init(int argc, char *argv[], EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO
 	
 	// Initializes global variables.
 	g_TmCanceled = 0;
+	memset( &g_TmProgress, 0, sizeof(g_TmProgress) );
+	g_TmProgress.startTime = GetTime();
 	
 	// Check parameters.
 	if ( (NULL == argv) || ((6 != argc) && (7 != argc)) ) {
@@ -227,10 +453,17 @@ static int Init(int argc, char *argv[], EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO
 		}
 		else {}
 		
-		p_jobInfo->p_raster = cupsRasterOpen( *p_InputFd, CUPS_RASTER_READ );
-		if ( NULL == p_jobInfo->p_raster ) {
+		p_jobInfo->p_stream = OpenRasterStream( *p_InputFd );
+		if ( NULL == p_jobInfo->p_stream ) {
 			return 1003;
 		}
+		
+		if ( 0 == p_jobInfo->p_stream->native ) { // Other formats are read by libcups.
+			p_jobInfo->p_raster = cupsRasterOpenIO( ReadStreamIO, p_jobInfo->p_stream, CUPS_RASTER_READ );
+			if ( NULL == p_jobInfo->p_raster ) {
+				return 1003;
+			}
+		}
 	}
 	
 	// Get parameters.
@@ -239,7 +472,8 @@ static int Init(int argc, char *argv[], EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO
 	
 	// Get printer name.
 	p_config->p_printerName = argv[0];
-	p_config->maxBandLines  = 256;
+	p_config->maxBandLines  = EPTMD_BAND_LINES;
+	p_config->jobId         = atoi( argv[1] );
 	
 	return EPTMD_SUCCESS;
 }
@@ -330,6 +564,21 @@ static int GetParameters(char *argv[], EPTMS_CONFIG_T *p_config)
 		if ( EPTMD_SUCCESS == result ) {
 			result = GetBuzzerAndDrawerFromPPD( p_ppd, p_config );
 		}
+		if ( EPTMD_SUCCESS == result ) {
+			result = GetDrawerKickFromPPD( p_ppd, p_config );
+		}
+		if ( EPTMD_SUCCESS == result ) {
+			result = GetSolidThinningFromPPD( p_ppd, p_config );
+		}
+		if ( EPTMD_SUCCESS == result ) {
+			result = GetRealTimeCommandFromPPD( p_ppd, p_config );
+		}
+		if ( EPTMD_SUCCESS == result ) {
+			result = GetCutModeFromPPD( p_ppd, p_config );
+		}
+		if ( EPTMD_SUCCESS == result ) {
+			result = GetResumeFromPPD( p_ppd, p_config );
+		}
 	}
 	// Unload the PPD file
 	ppdClose( p_ppd );
@@ -364,6 +613,34 @@ static int GetModelSpecificFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config)
 			return 4104;
 		}
 	}
+	{
+		char ppdKeyPrintSpeed[] = "TmxMaxPrintSpeed";
+		ppd_attr_t* p_attribute = ppdFindAttr( p_ppd, ppdKeyPrintSpeed, NULL );
+		if ( NULL == p_attribute ) { // PPD files of older versions do not have this attribute. (The print speed is not changed.)
+			p_config->maxPrintSpeed = 0;
+		}
+		else {
+			p_config->maxPrintSpeed = (unsigned)atol( p_attribute->value );
+			
+			if ( (0 == p_config->maxPrintSpeed) || (EPTMD_PRINT_SPEED_LIMIT < p_config->maxPrintSpeed) ) { // GS ( K Command Specification
+				return 4105;
+			}
+		}
+	}
+	{
+		char ppdKeyRealTimeSwitch[] = "TmxRealTimeSwitch";
+		ppd_attr_t* p_attribute = ppdFindAttr( p_ppd, ppdKeyRealTimeSwitch, NULL );
+		if ( NULL == p_attribute ) { // PPD files of older versions do not have this attribute. (Real-time commands are not disabled.)
+			p_config->realTimeSwitch = 0;
+		}
+		else if ( 0 == strcmp( "True", p_attribute->value ) ) {
+			p_config->realTimeSwitch = 1;
+		}
+		else if ( 0 == strcmp( "False", p_attribute->value ) ) {
+			p_config->realTimeSwitch = 0;
+		}
+		else { return 4106; }
+	}
 	
 	return EPTMD_SUCCESS;
 }
@@ -426,6 +703,30 @@ static int GetBuzzerAndDrawerFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config
 	return EPTMD_SUCCESS;
 }
 
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get drawer kick timing.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int GetDrawerKickFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config)
+{
+	char ppdKey[] = "TmxDrawerKick";
+	
+	ppd_choice_t* p_choice = ppdFindMarkedChoice( p_ppd, ppdKey );
+	if ( NULL == p_choice ) { // PPD files of older versions do not have this option.
+		p_config->drawerKick = TmDrawerKickQueued;
+		return EPTMD_SUCCESS;
+	}
+	
+	if ( 0 == strcmp( "Queued", p_choice->choice ) ) {
+		p_config->drawerKick = TmDrawerKickQueued;
+	}
+	else if ( 0 == strcmp( "RealTime", p_choice->choice ) ) {
+		p_config->drawerKick = TmDrawerKickRealTime;
+	}
+	else { return 4502; }
+	
+	return EPTMD_SUCCESS;
+}
+
 /*---------------------------------------------------------------------------------------------------------------------
  * Get cut type.
  *-------------------------------------------------------------------------------------------------------------------*/
@@ -450,6 +751,108 @@ static int GetPaperCutFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config)
 	return EPTMD_SUCCESS;
 }
 
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get solid fill thinning settings.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int GetSolidThinningFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config)
+{
+	char ppdKey[] = "TmxSolidThinning";
+	
+	ppd_choice_t* p_choice = ppdFindMarkedChoice( p_ppd, ppdKey );
+	if ( NULL == p_choice ) { // PPD files of older versions do not have this option.
+		p_config->solidThinning = TmSolidThinningOff;
+		return EPTMD_SUCCESS;
+	}
+	
+	if ( 0 == strcmp( "Off", p_choice->choice ) ) {
+		p_config->solidThinning = TmSolidThinningOff;
+	}
+	else if ( 0 == strcmp( "Checkerboard", p_choice->choice ) ) {
+		p_config->solidThinning = TmSolidThinningCheckerboard;
+	}
+	else if ( 0 == strcmp( "EdgePreserving", p_choice->choice ) ) {
+		p_config->solidThinning = TmSolidThinningEdgePreserving;
+	}
+	else { return 4602; }
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get real-time command handling settings.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int GetRealTimeCommandFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config)
+{
+	char ppdKey[] = "TmxRealTimeCommand";
+	
+	ppd_choice_t* p_choice = ppdFindMarkedChoice( p_ppd, ppdKey );
+	if ( NULL == p_choice ) { // PPD files of older versions do not have this option.
+		p_config->realTimeCommand = TmRealTimeCommandPatch;
+		return EPTMD_SUCCESS;
+	}
+	
+	if ( 0 == strcmp( "Patch", p_choice->choice ) ) {
+		p_config->realTimeCommand = TmRealTimeCommandPatch;
+	}
+	else if ( 0 == strcmp( "Disable", p_choice->choice ) ) {
+		p_config->realTimeCommand = TmRealTimeCommandDisable;
+		
+		// GS ( D would drop the real-time drawer kick. (DLE DC4 <fn 1>)
+		if ( TmDrawerKickRealTime == p_config->drawerKick ) { return 4703; }
+	}
+	else { return 4702; }
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get cut timing.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int GetCutModeFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config)
+{
+	char ppdKey[] = "TmxCutMode";
+	
+	ppd_choice_t* p_choice = ppdFindMarkedChoice( p_ppd, ppdKey );
+	if ( NULL == p_choice ) { // PPD files of older versions do not have this option.
+		p_config->cutMode = TmCutImmediate;
+		return EPTMD_SUCCESS;
+	}
+	
+	if ( 0 == strcmp( "Immediate", p_choice->choice ) ) {
+		p_config->cutMode = TmCutImmediate;
+	}
+	else if ( 0 == strcmp( "Reserved", p_choice->choice ) ) {
+		p_config->cutMode = TmCutReserved;
+	}
+	else { return 4802; }
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get resume settings.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int GetResumeFromPPD(ppd_file_t *p_ppd, EPTMS_CONFIG_T *p_config)
+{
+	char ppdKey[] = "TmxResume";
+	
+	ppd_choice_t* p_choice = ppdFindMarkedChoice( p_ppd, ppdKey );
+	if ( NULL == p_choice ) { // PPD files of older versions do not have this option.
+		p_config->resume = TmResumeOff;
+		return EPTMD_SUCCESS;
+	}
+	
+	if ( 0 == strcmp( "Off", p_choice->choice ) ) {
+		p_config->resume = TmResumeOff;
+	}
+	else if ( 0 == strcmp( "Band", p_choice->choice ) ) {
+		p_config->resume = TmResumeBand;
+	}
+	else { return 4902; }
+	
+	return EPTMD_SUCCESS;
+}
+
 /*---------------------------------------------------------------------------------------------------------------------
  * Finalizes process.
  *-------------------------------------------------------------------------------------------------------------------*/
@@ -460,6 +863,11 @@ static void Exit(EPTMS_JOB_INFO_T* p_jobInfo, int* p_InputFd)
 		p_jobInfo->p_raster = NULL;
 	}
 	
+	if ( NULL != p_jobInfo->p_stream ) {
+		free( p_jobInfo->p_stream );
+		p_jobInfo->p_stream = NULL;
+	}
+	
 	if ( 0 < *p_InputFd ) {
 		close( *p_InputFd );
 		*p_InputFd = -1;
@@ -478,12 +886,13 @@ static int DoJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 	
 	while ( EPTMD_SUCCESS == result )
 	{
-		if ( 0 == cupsRasterReadHeader( p_jobInfo->p_raster, &p_jobInfo->pageHeader ) ) {
+		if ( 0 == ReadRasterHeader( p_jobInfo ) ) {
 			result = EPTMD_SUCCESS;
 			break;
 		}
 		
 		page++;
+		g_TmProgress.page = page;
 		fprintf( stderr, "PAGE: %u %d\n"                 , page, p_jobInfo->pageHeader.NumCopies  );
 		fprintf( stderr, "DEBUG: cupsBytesPerLine = %u\n", p_jobInfo->pageHeader.cupsBytesPerLine );
 		fprintf( stderr, "DEBUG: cupsBitsPerPixel = %u\n", p_jobInfo->pageHeader.cupsBitsPerPixel );
@@ -496,6 +905,10 @@ static int DoJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 			break;
 		}
 		
+		// Decide magnification. (Draft resolution is printed with the printer magnification.)
+		p_config->h_magnification = GetMagnification( p_config->h_motionUnit, p_jobInfo->pageHeader.HWResolution[0] );
+		p_config->v_magnification = GetMagnification( p_config->v_motionUnit, p_jobInfo->pageHeader.HWResolution[1] );
+		
 		if ( NULL == p_jobInfo->p_pageBuffer ) { // Allocate buffer of page.
 			long size = p_jobInfo->pageHeader.cupsHeight * EPTMD_BITS_TO_BYTES( p_jobInfo->pageHeader.cupsWidth );
 			p_jobInfo->p_pageBuffer = (unsigned char *)malloc( size );
@@ -516,12 +929,25 @@ static int DoJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 	}
 	
 	if ( EPTMD_SUCCESS != result ) {
+		p_config->cutMode = TmCutImmediate;	// No job may follow to execute a reserved cut.
 		EndJob( p_config, p_jobInfo, &p_jobInfo->pageHeader );
 	}
 	else {
 		result = EndJob( p_config, p_jobInfo, &p_jobInfo->pageHeader );
 	}
 	
+	// Record the printer state for the next job. (Only a completed job leaves a known state. A reserved cut is recorded by EndJob.)
+	if ( (EPTMD_SUCCESS == result) && (0 != p_config->state.initialized) && (0 == p_config->state.cutReserved) ) {
+		if ( EPTMD_SUCCESS != SaveState( p_config ) ) {
+			fprintf( stderr, "DEBUG: Printer state is not recorded.\n" );
+		}
+	}
+	
+	// The checkpoint is kept until the job is completed. (CUPS runs the filter again to retry the job.)
+	if ( EPTMD_SUCCESS == result ) {
+		RemoveCheckpointFile( p_config->p_printerName );
+	}
+	
 	return result;
 }
 
@@ -531,42 +957,54 @@ static int DoJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 static int StartJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
 {
 	int result = EPTMD_SUCCESS;
+	int answered = 1;
 	
 	if ( 0 != g_TmCanceled ) {
 		return EPTMD_CANCEL;
 	}
 	
-	{ // Write configuration commands.
-		unsigned char CommandSetDevice[3+2] = { ESC, '=', 0x01, ESC, '@' };
+	// Resume the job interrupted by an output failure. (The drawer and the buzzer were already operated.)
+	ResumeJob( p_config );
+	
+	// Clear the data left by the interrupted run. (Sent first : the printer may still be waiting for the rest of a command.)
+	if ( 0 != p_config->checkpoint.resumed ) {
+		result = ClearBuffer( p_config, &answered );
+		if ( EPTMD_SUCCESS != result ) { return 2110; }
+	}
+	
+	// Drawer open. (A real-time command does not wait for the data in the receive buffer.)
+	if ( (TmDrawerKickRealTime == p_config->drawerKick) && (0 == p_config->checkpoint.resumed) ) {
+		result = OpenDrawer( p_config );
+		if ( EPTMD_SUCCESS != result ) { return 2106; }
+	}
+	
+	{ // Select printer.
+		unsigned char CommandSetDevice[3] = { ESC, '=', 0x01 };
 		result = WriteData( CommandSetDevice, sizeof(CommandSetDevice) );
 		if ( EPTMD_SUCCESS != result ) { return 2101; }
-		
-		unsigned char CommandSetPrintSheet[4] = { ESC, 'c', '0', 0x02 };
-		result = WriteData( CommandSetPrintSheet, sizeof(CommandSetPrintSheet) );
-		if ( EPTMD_SUCCESS != result ) { return 2102; }
-		
-		unsigned char CommandSetConfigSheet[4] = { ESC, 'c', '1', 0x02 };
-		result = WriteData( CommandSetConfigSheet, sizeof(CommandSetConfigSheet) );
-		if ( EPTMD_SUCCESS != result ) { return 2103; }
-		
-		unsigned char CommandSetNearendPrint[4] = { ESC, 'c', '3', 0x00 };
-		result = WriteData( CommandSetNearendPrint, sizeof(CommandSetNearendPrint) );
-		if ( EPTMD_SUCCESS != result ) { return 2104; }
-		
-		unsigned char CommandSetBaseMotionUnit[4] = { GS, 'P', 0x00, 0x00 };
-		CommandSetBaseMotionUnit[2] = p_config->h_motionUnit;
-		CommandSetBaseMotionUnit[3] = p_config->v_motionUnit;
-		result = WriteData( CommandSetBaseMotionUnit, sizeof(CommandSetBaseMotionUnit) );
-		if ( EPTMD_SUCCESS != result ) { return 2105; }
 	}
 	
+	// Get printer capabilities. (The PPD settings are used if the printer does not answer.)
+	if ( 0 != answered ) {
+		GetCapability( p_config );
+	}
+	p_config->checkpoint.enabled = CanTrackCheckpoint( p_config );
+	
+	// Write configuration commands.
+	result = InitPrinter( p_config );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+	
 	// Drawer open.
-	result = OpenDrawer( p_config );
-	if ( EPTMD_SUCCESS != result ) { return 2106; }
+	if ( (TmDrawerKickQueued == p_config->drawerKick) && (0 == p_config->checkpoint.resumed) ) {
+		result = OpenDrawer( p_config );
+		if ( EPTMD_SUCCESS != result ) { return 2106; }
+	}
 	
 	// Sound buzzer.
-	result = SoundBuzzer( p_config );
-	if ( EPTMD_SUCCESS != result ) { return 2107; }
+	if ( 0 == p_config->checkpoint.resumed ) {
+		result = SoundBuzzer( p_config );
+		if ( EPTMD_SUCCESS != result ) { return 2107; }
+	}
 	
 	// Send user file.
 	result = WriteUserFile( p_config->p_printerName, "StartJob.prn" );
@@ -586,10 +1024,18 @@ static int OpenDrawer(EPTMS_CONFIG_T* p_config)
 		return EPTMD_SUCCESS;
 	}
 	
-	unsigned char Command[5] = { ESC, 'p', 0, 50 /* on time */, 200 /* off time */ };
-	Command[2] = p_config->drawerControl - 1; // pin no
-	
-	result = WriteData( Command, sizeof(Command) );
+	if ( TmDrawerKickRealTime == p_config->drawerKick ) {
+		unsigned char Command[5] = { DLE, 0x14, 1, 0, 1 /* pulse time (x 100 ms) */ };
+		Command[3] = p_config->drawerControl - 1; // pin no
+		
+		result = WriteData( Command, sizeof(Command) );
+	}
+	else {
+		unsigned char Command[5] = { ESC, 'p', 0, 50 /* on time */, 200 /* off time */ };
+		Command[2] = p_config->drawerControl - 1; // pin no
+		
+		result = WriteData( Command, sizeof(Command) );
+	}
 	
 	return result;
 }
@@ -643,297 +1089,1608 @@ static int EndJob(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo, cups_pa
 	switch ( p_config->cutControl )
 	{
 		case TmCutPerJob:
-			result = WriteData( Command, sizeof(Command) );
-			if ( EPTMD_SUCCESS != result ) { return 2202; }
-			
-			result = FeedPaper( p_config, p_header, ((p_config->v_motionUnit * 10) / 254) );
-			if ( EPTMD_SUCCESS != result ) { return 2203; }
+			p_config->cutPending = 1;
 			break;
 		
 		default:
 			break;
 	}
 	
+	if ( 0 != p_config->cutPending ) {
+		p_config->cutPending = 0;
+		
+		if ( (TmCutReserved == p_config->cutMode) && (0 != WaitNextJob( p_config )) ) { // The next job feeds the paper to the cutter.
+			// Without the recorded reservation, ESC @ of the next job would discard the cut.
+			p_config->state.cutReserved = 1;
+			if ( (EPTMD_SUCCESS != SaveState( p_config )) || (EPTMD_SUCCESS != WatchReservedCut( p_config )) ) {
+				fprintf( stderr, "DEBUG: Reserved cut is not recorded.\n" );
+				p_config->state.cutReserved = 0;
+			}
+		}
+		
+		if ( 0 != p_config->state.cutReserved ) {
+			result = ReserveCut();
+			if ( EPTMD_SUCCESS != result ) { return 2204; }
+		}
+		else {
+			result = WriteData( Command, sizeof(Command) );
+			if ( EPTMD_SUCCESS != result ) { return 2202; }
+			
+			result = FeedPaper( p_config, p_header, ((p_header->HWResolution[1] * 10) / 254) );
+			if ( EPTMD_SUCCESS != result ) { return 2203; }
+		}
+	}
+	
 	return EPTMD_SUCCESS;
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * Processing print page.
+ * Reserve paper cut at the current position. (GS V <Function C> : partial cut)
  *-------------------------------------------------------------------------------------------------------------------*/
-static int DoPage(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
+static int ReserveCut(void)
 {
-	int result;
-	
-	result = StartPage( p_config );
-	
-	if ( EPTMD_SUCCESS == result ) {
-		result = ReadRaster( &p_jobInfo->pageHeader, p_jobInfo->p_raster, p_jobInfo->p_pageBuffer );
-	}
-	
-	if ( EPTMD_SUCCESS == result ) {
-		result = WriteRaster( p_config, &p_jobInfo->pageHeader, p_jobInfo->p_pageBuffer );
-	}
-	
-	if ( EPTMD_SUCCESS == result ) {
-		result = EndPage( p_config, &p_jobInfo->pageHeader );
-	}
+	unsigned char Command[4] = { GS, 'V', 98, 0 };
 	
-	return result;
+	return WriteData( Command, sizeof(Command) );
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * Start page.
+ * Wait for the next job of the printer. (Returns 1 if a job is pending)
  *-------------------------------------------------------------------------------------------------------------------*/
-static int StartPage(EPTMS_CONFIG_T* p_config)
+static int WaitNextJob(EPTMS_CONFIG_T* p_config)
 {
-	int result;
+	double limit = GetTime() + EPTMD_NEXT_JOB_TIMEOUT;
 	
-	// Send user file.
-	result = WriteUserFile( p_config->p_printerName, "StartPage.prn" );
-	if ( EPTMD_SUCCESS != result ) { return 3102; }
+	do {
+		if ( 0 != HasOtherJob( p_config, IPP_JOB_PENDING ) ) {
+			return 1;
+		}
+		if ( 0 == HasOtherJob( p_config, IPP_JOB_PROCESSING ) ) { // No job is about to become pending. (A held job may wait for hours.)
+			return 0;
+		}
+		if ( 0 != g_TmCanceled ) {
+			return 0;
+		}
+		
+		usleep( EPTMD_NEXT_JOB_INTERVAL );
+	} while ( GetTime() < limit );
 	
-	return EPTMD_SUCCESS;
+	return 0;
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * End page.
+ * Check if another job of the printer is in the state.
  *-------------------------------------------------------------------------------------------------------------------*/
-static int EndPage(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header)
+static int HasOtherJob(EPTMS_CONFIG_T* p_config, ipp_jstate_t state)
 {
-	int result;
-	
-	if ( 0 != g_TmCanceled ) {
-		return EPTMD_CANCEL;
+	cups_job_t* p_jobs = NULL;
+	int found = 0;
+	
+	int num_jobs = cupsGetJobs2( CUPS_HTTP_DEFAULT, &p_jobs, p_config->p_printerName, 0, CUPS_WHICHJOBS_ACTIVE );
+	if ( 0 < num_jobs ) {
+		int i;
+		for ( i = 0; i < num_jobs; i++ ) {
+			if ( (p_config->jobId != p_jobs[i].id) && (state == p_jobs[i].state) ) {
+				found = 1;
+			}
+		}
+		cupsFreeJobs( num_jobs, p_jobs );
 	}
 	
-	// Send user file.
-	result = WriteUserFile( p_config->p_printerName, "EndPage.prn" );
-	if ( EPTMD_SUCCESS != result ) { return 3201; }
-	
-	// Feed and cut paper.
+	return found;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Watch the reserved cut after the job. (The next job may be canceled, held or fail before it starts.)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int WatchReservedCut(EPTMS_CONFIG_T* p_config)
+{
+	pid_t pid = fork();
+	if ( 0 > pid ) {
+		return EPTMD_FAILED;
+	}
+	else if ( 0 < pid ) {
+		return EPTMD_SUCCESS;
+	}
+	else {}
+	
+	// The watcher must not hold the job open. (Output, backchannel and log)
+	setsid();
+	int fd = open( "/dev/null", O_RDWR );
+	if ( 0 <= fd ) {
+		dup2( fd, 0 );
+		dup2( fd, 1 );
+		dup2( fd, 2 );
+		dup2( fd, 3 );
+		if ( 3 < fd ) {
+			close( fd );
+		}
+	}
+	
+	sleep( EPTMD_RESERVED_CUT_TIMEOUT );
+	
+	// The next job removes the state when it starts, and a job in progress feeds the paper.
+	EPTMS_PRINTER_STATE_T state = { 0 };
+	if ( (EPTMD_SUCCESS == ReadStateFile( p_config->p_printerName, &state ))
+	  && (0 != state.cutReserved) && (p_config->state.time == state.time)
+	  && (0 == HasOtherJob( p_config, IPP_JOB_PENDING )) && (0 == HasOtherJob( p_config, IPP_JOB_PROCESSING )) ) {
+		// The cut job initializes the printer, so the next job must initialize it again.
+		RemoveStateFile( p_config->p_printerName );
+		SubmitCut( p_config->p_printerName );
+	}
+	
+	_exit( 0 );
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Submit the reserved cut as a raw job. (ESC @ cancels the reservation, so that the paper is cut only once)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int SubmitCut(char* p_printerName)
+{
+	unsigned char Command[2+3+4] = { ESC, '@', ESC, 'J', 0, GS, 'V', 66, 0 };
+	
+	int job_id = cupsCreateJob( CUPS_HTTP_DEFAULT, p_printerName, "Paper cut", 0, NULL );
+	if ( 0 >= job_id ) {
+		return EPTMD_FAILED;
+	}
+	if ( HTTP_CONTINUE != cupsStartDocument( CUPS_HTTP_DEFAULT, p_printerName, job_id, "Paper cut", CUPS_FORMAT_RAW, 1 ) ) {
+		return EPTMD_FAILED;
+	}
+	if ( HTTP_CONTINUE != cupsWriteRequestData( CUPS_HTTP_DEFAULT, (const char*)Command, sizeof(Command) ) ) {
+		cupsFinishDocument( CUPS_HTTP_DEFAULT, p_printerName );
+		return EPTMD_FAILED;
+	}
+	if ( IPP_OK != cupsFinishDocument( CUPS_HTTP_DEFAULT, p_printerName ) ) {
+		return EPTMD_FAILED;
+	}
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Save printer state for the next job.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int SaveState(EPTMS_CONFIG_T* p_config)
+{
+	// The status may have changed during the job. (Paper, cover or error)
+	if ( (0 == p_config->capability.probed) || (EPTMD_SUCCESS != GetPrinterStatus( p_config->state.status )) ) {
+		memset( p_config->state.status, 0, sizeof(p_config->state.status) );	// Unknown : the next job initializes the printer.
+	}
+	p_config->state.time = (long)time( NULL );
+	
+	return WriteStateFile( p_config->p_printerName, &p_config->state );
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Processing print page.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int DoPage(EPTMS_CONFIG_T* p_config, EPTMS_JOB_INFO_T* p_jobInfo)
+{
+	int result = EPTMD_SUCCESS;
+	
+	if ( 0 == IsPrinted( p_config ) ) {
+		result = StartPage( p_config );
+	}
+	else { // Printed before the job was interrupted. (Including the reserved cut)
+		p_config->cutPending = 0;
+	}
+	
+	if ( EPTMD_SUCCESS == result ) {
+		if ( NULL != p_jobInfo->p_raster ) {
+			p_jobInfo->inkLines.known = 0;
+			result = ReadRaster( &p_jobInfo->pageHeader, p_jobInfo->p_raster, p_jobInfo->p_pageBuffer );
+		}
+		else {
+			result = DecodeRaster( &p_jobInfo->pageHeader, p_jobInfo->p_stream, p_jobInfo->p_pageBuffer, EPTMD_BITS_TO_BYTES( p_jobInfo->pageHeader.cupsWidth ), &p_jobInfo->inkLines );
+			if ( EPTMD_FAILED == result ) { result = 3303; }
+		}
+	}
+	
+	if ( EPTMD_SUCCESS == result ) {
+		result = WriteRaster( p_config, &p_jobInfo->pageHeader, p_jobInfo->p_pageBuffer, &p_jobInfo->inkLines );
+	}
+	
+	if ( EPTMD_SUCCESS == result ) {
+		result = EndPage( p_config, &p_jobInfo->pageHeader );
+	}
+	
+	return result;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Start page.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int StartPage(EPTMS_CONFIG_T* p_config)
+{
+	int result;
+	
+	// Reserve the cut of the previous page. (Executed while this page is printed.)
+	if ( 0 != p_config->cutPending ) {
+		result = ReserveCut();
+		if ( EPTMD_SUCCESS != result ) { return 3103; }
+		
+		p_config->cutPending = 0;
+	}
+	
+	// Send user file.
+	result = WriteUserFile( p_config->p_printerName, "StartPage.prn" );
+	if ( EPTMD_SUCCESS != result ) { return 3102; }
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * End page.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int EndPage(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header)
+{
+	int result;
+	
+	if ( 0 != g_TmCanceled ) {
+		return EPTMD_CANCEL;
+	}
+	
+	if ( 0 != IsPrinted( p_config ) ) { // Printed before the job was interrupted. (The reserved cut is sent again by the next page.)
+		p_config->cutPending = ((TmCutPerPage == p_config->cutControl) && (TmCutReserved == p_config->cutMode)) ? 1 : 0;
+		return PassCheckpoint( p_config );
+	}
+	
+	// Send user file.
+	result = WriteUserFile( p_config->p_printerName, "EndPage.prn" );
+	if ( EPTMD_SUCCESS != result ) { return 3201; }
+	
+	// Feed and cut paper.
 	unsigned char Command[3+4] = { ESC, 'J', 0, GS, 'V', 66, 0 };
 	switch ( p_config->cutControl )
 	{
 		case TmCutPerPage:
+			if ( TmCutReserved == p_config->cutMode ) { // Cut when the next page or job feeds the paper.
+				p_config->cutPending = 1;
+				break;
+			}
+			
 			result = WriteData( Command, sizeof(Command) );
 			if ( EPTMD_SUCCESS != result ) { return 3202; }
 			
-			result = FeedPaper( p_config, p_header, ((p_config->v_motionUnit * 10) / 254) );
+			result = FeedPaper( p_config, p_header, ((p_header->HWResolution[1] * 10) / 254) );
 			if ( EPTMD_SUCCESS != result ) { return 3203; }
 			break;
 		
-		default:
-			break;
+		default:
+			break;
+	}
+	
+	result = PassCheckpoint( p_config );
+	if ( EPTMD_SUCCESS != result ) { return 3204; }
+	
+	// The responses to the last band and the page end arrive after they are printed, and no band of this page follows to read them.
+	// (The wait is bounded, so that the next page is sent while the printer is still printing a long page.)
+	if ( 0 != p_config->checkpoint.enabled ) {
+		ReadCheckpoint( p_config, EPTMD_CHECKPOINT_TIMEOUT );
+	}
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read raster data of one page.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int ReadRaster(cups_page_header_t* p_header, cups_raster_t* p_raster, unsigned char* p_pageBuffer)
+{
+	int				result = EPTMD_SUCCESS;
+	unsigned char*	p_data;
+	unsigned		data_size = p_header->cupsBytesPerLine;
+	
+	p_data = (unsigned char*)malloc( data_size );
+	if ( NULL == p_data ) {
+		return 3301;
+	}
+	memset( p_data, 0, data_size );
+	
+	unsigned i;
+	for ( i = 0; i < p_header->cupsHeight; i++ ) {
+		if ( 0 != g_TmCanceled ) {
+			result = EPTMD_CANCEL;
+			break;
+		}
+		
+		unsigned num_bytes_read = cupsRasterReadPixels( p_raster, p_data, data_size );
+		if ( data_size > num_bytes_read ) {
+			fprintf( stderr, "DEBUG: cupsRasterReadPixels() = %u:%u/%u\n", (i + 1), num_bytes_read, data_size );
+			result = 3302;
+			break;
+		}
+		
+		TransferRaster( p_pageBuffer, p_data, p_header, i );
+	}
+	
+	free( p_data );
+	
+	return result;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Transfer raster to page buffer for 1bit per pixel data.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static void TransferRaster(unsigned char* p_pageBuffer, unsigned char *p_data, cups_page_header_t* p_header, unsigned line_no)
+{
+	unsigned char*	p_dest   = p_pageBuffer + (EPTMD_BITS_TO_BYTES( p_header->cupsWidth ) * line_no );
+	
+	memcpy( p_dest, p_data, p_header->cupsBytesPerLine );
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read page header.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static unsigned ReadRasterHeader(EPTMS_JOB_INFO_T* p_jobInfo)
+{
+	if ( NULL != p_jobInfo->p_raster ) {
+		return cupsRasterReadHeader( p_jobInfo->p_raster, &p_jobInfo->pageHeader );
+	}
+	
+	return ReadStreamHeader( p_jobInfo->p_stream, &p_jobInfo->pageHeader );
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Write raster data of one page.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int WriteRaster(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, unsigned char* p_pageBuffer, EPTMS_INK_LINES_T* p_inkLines)
+{
+	unsigned 		start_line_no = 0;	/* first raster line without top blank */
+	unsigned 		last_line_no  = 0;	/* last raster line without bottom blank */
+	int				result = EPTMD_SUCCESS;
+	
+	// Get top margin (Already known if the page was decoded by the filter.)
+	if ( 0 != p_inkLines->known ) {
+		start_line_no = p_inkLines->top;
+	}
+	else {
+		start_line_no = FindBlackRasterLineTop( p_header, p_pageBuffer );
+	}
+	if( p_header->cupsHeight == start_line_no ) { /* This page has not image */
+		if ( (TmPaperReductionOff == p_config->paperReduction) && (0 == IsPrinted( p_config )) ) {
+			result = FeedPaper( p_config, p_header, p_header->cupsHeight );
+			if ( EPTMD_SUCCESS != result ) { return 3401; }
+		}
+		return EPTMD_SUCCESS;
+	}
+	
+	// Get bottom margin
+	if ( 0 != p_inkLines->known ) {
+		last_line_no = p_inkLines->end;
+	}
+	else {
+		last_line_no = FindBlackRasterLineEnd( p_header, p_pageBuffer ) + 1;
+	}
+	
+	StartProgress( g_TmProgress.page, (last_line_no - start_line_no) );
+	
+	// Avoid disturbing data
+	AvoidDisturbingData( p_pageBuffer + (EPTMD_BITS_TO_BYTES( p_header->cupsWidth ) * start_line_no),
+						 (unsigned long)(last_line_no - start_line_no) * EPTMD_BITS_TO_BYTES( p_header->cupsWidth ),
+						 CanDisableRealTimeCommand( p_config ) );
+	
+	// Command output : top margin (Bands printed before the job was interrupted are skipped.)
+	if ( !((TmPaperReductionTop == p_config->paperReduction) || (TmPaperReductionBoth == p_config->paperReduction)) && (0 == IsPrinted( p_config )) ) {
+		result = FeedPaper( p_config, p_header, start_line_no );
+		if ( EPTMD_SUCCESS != result ) { return 3402; }
+	}
+	// Command output : disable real-time commands
+	if ( 0 != CanDisableRealTimeCommand( p_config ) ) {
+		result = EnableRealTimeCommand( p_config, 0 );
+		if ( EPTMD_SUCCESS != result ) { return 3407; }
+	}
+	// Command output : raster data (band unit)
+	result = WriteBands( p_config, p_header, p_pageBuffer, start_line_no, last_line_no );
+	if ( EPTMD_SUCCESS != result ) {
+		if ( EPTMD_CANCEL == result ) {
+			EnableRealTimeCommand( p_config, 1 );
+		}
+		return result;
+	}
+	// Command output : enable real-time commands
+	result = EnableRealTimeCommand( p_config, 1 );
+	if ( EPTMD_SUCCESS != result ) { return 3408; }
+	// Command output : print speed
+	result = SelectPrintSpeed( p_config, EPTMD_PRINT_SPEED_CUSTOM );
+	if ( EPTMD_SUCCESS != result ) { return 3406; }
+	// Command output : Bottom margin
+	if ( !((TmPaperReductionBottom == p_config->paperReduction) || (TmPaperReductionBoth == p_config->paperReduction)) && (0 == IsPrinted( p_config )) ) {
+		result = FeedPaper( p_config, p_header, (p_header->cupsHeight - last_line_no) );
+		if ( EPTMD_SUCCESS != result ) { return 3405; }
+	}
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Write raster data of one page in bands.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int WriteBands(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, unsigned char* p_pageBuffer, unsigned start_line_no, unsigned last_line_no)
+{
+	// Solid areas are thinned band by band just before the band is sent. A thinned band that is no longer dense
+	// needs less head energy and is printed at the highest speed of the model, the other bands at the customized speed.
+	// Thinning keeps the pixel doubling found in the band, so the band is still sent at half size.
+	
+	unsigned       BytesPerLine = EPTMD_BITS_TO_BYTES( p_header->cupsWidth );
+	unsigned char* p_above      = NULL;						// Original data of the line above the band
+	unsigned long  thinned_page = 0;
+	int            result       = EPTMD_SUCCESS;
+	
+	if ( TmSolidThinningOff != p_config->solidThinning ) {
+		p_above = (unsigned char*)malloc( BytesPerLine * 2 );
+		if ( NULL != p_above ) {
+			memset( p_above, 0, BytesPerLine );
+		}
+	}
+	
+	unsigned BandLines = GetBandLines( p_config, BytesPerLine );
+	unsigned line_no;
+	for ( line_no = start_line_no; line_no < last_line_no; line_no += BandLines ) {
+		unsigned       lines  = ((line_no + BandLines) < last_line_no) ? BandLines : (last_line_no - line_no);
+		unsigned char* p_data = p_pageBuffer + (BytesPerLine * line_no);
+		
+		// Bands of doubled pixels are sent at half size and magnified by the printer.
+		// (Not on a magnified page, the printer magnifies up to 2 times.)
+		unsigned h_scale = 1;
+		unsigned v_scale = 1;
+		FindMagnification( p_data, BytesPerLine, lines, &h_scale, &v_scale );
+		if ( 1 < p_config->h_magnification ) {
+			h_scale = 1;
+		}
+		if ( 1 < p_config->v_magnification ) {
+			v_scale = 1;
+		}
+		
+		unsigned long thinned = 0;
+		int           fast    = 0;
+		if ( NULL != p_above ) {
+			thinned = ThinSolidFill( p_config, p_header, p_data, line_no, lines, ((line_no + lines) < last_line_no) ? 1 : 0, p_above, h_scale, v_scale );
+			thinned_page += thinned;
+			
+			if ( 0 != thinned ) {
+				unsigned long dots = CountDots( p_data, (unsigned long)BytesPerLine * lines );
+				fast = ((dots * 100) <= ((unsigned long)BytesPerLine * 8 * lines * EPTMD_THINNING_DENSITY)) ? 1 : 0;
+			}
+		}
+		
+		if ( 0 == IsPrinted( p_config ) ) {
+			if ( 0 != p_config->maxPrintSpeed ) {
+				result = SelectPrintSpeed( p_config, (0 != fast) ? p_config->maxPrintSpeed : EPTMD_PRINT_SPEED_CUSTOM );
+				if ( EPTMD_SUCCESS != result ) {
+					result = 3406;
+					break;
+				}
+			}
+			
+			result = WriteBand( p_config, p_header, p_data, lines, h_scale, v_scale );
+			if ( EPTMD_SUCCESS != result ) {
+				result = ((line_no + lines) < last_line_no) ? 3403 : 3404;
+				break;
+			}
+		}
+		result = PassCheckpoint( p_config );
+		if ( EPTMD_SUCCESS != result ) {
+			result = 3409;
+			break;
+		}
+		ReportProgress( lines, ((line_no + lines) < last_line_no) ? 0 : 1 );
+		
+		if ( 0 != g_TmCanceled ) {
+			result = EPTMD_CANCEL;
+			break;
+		}
+	}
+	
+	if ( NULL != p_above ) {
+		fprintf( stderr, "DEBUG: Thinned dots = %lu\n", thinned_page );
+		free( p_above );
+	}
+	
+	return result;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get the band length of a page. (A GS 8 L band must fit in the download graphics memory.)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static unsigned GetBandLines(EPTMS_CONFIG_T* p_config, unsigned BytesPerLine)
+{
+	unsigned long capacity = p_config->capability.bufferCapacity;
+	
+	if ( (0 == p_config->capability.probed) || (TmGraphicsRaster != p_config->capability.graphicsCommand) || (0 == capacity) || (0 == BytesPerLine) ) {
+		return p_config->maxBandLines;
+	}
+	if ( (capacity / BytesPerLine) >= p_config->maxBandLines ) {
+		return p_config->maxBandLines;
+	}
+	
+	return (BytesPerLine <= capacity) ? (unsigned)(capacity / BytesPerLine) : 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Avoid disturbing data. (DLE DC4 <Function 1> and <Function 2> are kept while they are disabled by GS ( D)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static void AvoidDisturbingData(unsigned char* p_data, unsigned long data_size, int realTimeDisabled)
+{
+    unsigned long i = 0;
+	for ( ; (i + 1) < data_size; i++ ) {
+		if ( 0x10 == p_data[i] ) {
+			if ( (0x04 == p_data[i+1]) || (0x05 == p_data[i+1]) ) {
+				p_data[i] = 0x30;
+			}
+			else if ( 0x14 == p_data[i+1] ) { // GS ( D does not disable the other functions.
+				if ( (0 == realTimeDisabled) || ((i + 2) >= data_size) || ((0x01 != p_data[i+2]) && (0x02 != p_data[i+2])) ) {
+					p_data[i] = 0x30;
+				}
+			}
+		}
+		else if ( 0x1B == p_data[i] ) {
+			if ( 0x3D == p_data[i+1] ) {
+				p_data[i] = 0x3B;
+			}
+		}
+		else {}
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Thin solid areas of a band with a checkerboard mask. (Returns the number of removed dots)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static unsigned long ThinSolidFill(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, unsigned char* p_band, unsigned band_no, unsigned lines, int has_below, unsigned char* p_above, unsigned h_scale, unsigned v_scale)
+{
+	// Only bytes of 8 black dots are thinned. Checkerboard keeps the left and right byte of a run (text strokes,
+	// vertical edges). EdgePreserving also keeps the top and bottom line of an area.
+	// p_above holds the original data of the line above the band (BytesPerLine * 2 bytes, the second half is work),
+	// and is updated to the original data of the last line of the band.
+	// A band of doubled pixels is thinned with doubled checks (2 dots wide, 2 lines high), so it stays doubled.
+	
+	unsigned       BytesPerLine = EPTMD_BITS_TO_BYTES( p_header->cupsWidth );
+	unsigned long  thinned = 0;
+	unsigned char* p_current = p_above + BytesPerLine;		// Original data of the current line
+	
+	unsigned long dots = CountDots( p_band, (unsigned long)BytesPerLine * lines );
+	if ( (dots * 100) <= ((unsigned long)BytesPerLine * 8 * lines * EPTMD_THINNING_DENSITY) ) {
+		memcpy( p_above, p_band + (BytesPerLine * (lines - 1)), BytesPerLine );
+		return 0;
+	}
+	
+	unsigned y;
+	for ( y = 0; y < lines; y += v_scale ) {
+		unsigned char* p_data  = p_band + (BytesPerLine * y);
+		unsigned char* p_below = (((y + v_scale) < lines) || (0 != has_below)) ? (p_data + (BytesPerLine * v_scale)) : NULL;
+		unsigned char  mask    = ((band_no + (y / v_scale)) & 1) ? ((2 == h_scale) ? 0x33 : 0x55) : ((2 == h_scale) ? 0xCC : 0xAA);
+		
+		memcpy( p_current, p_data, BytesPerLine );
+		
+		unsigned x;
+		for ( x = 1; (x + 1) < BytesPerLine; x++ ) {
+			if ( (0xFF != p_current[x]) || (0xFF != p_current[x-1]) || (0xFF != p_current[x+1]) ) {
+				continue;
+			}
+			if ( TmSolidThinningEdgePreserving == p_config->solidThinning ) {
+				if ( (0xFF != p_above[x]) || (NULL == p_below) || (0xFF != p_below[x]) ) {
+					continue;
+				}
+			}
+			p_data[x] = mask;
+			thinned  += 4 * v_scale;
+		}
+		if ( 2 == v_scale ) {
+			memcpy( p_data + BytesPerLine, p_data, BytesPerLine );
+		}
+		
+		memcpy( p_above, p_current, BytesPerLine );
+	}
+	
+	return thinned;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Count black dots.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static unsigned long CountDots(unsigned char* p_data, unsigned long data_size)
+{
+	static const unsigned char DotsPerNibble[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+	unsigned long dots = 0;
+	
+	unsigned long i;
+	for ( i = 0; i < data_size; i++ ) {
+		dots += DotsPerNibble[p_data[i] >> 4] + DotsPerNibble[p_data[i] & 0x0F];
+	}
+	
+	return dots;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Select print speed.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int SelectPrintSpeed(EPTMS_CONFIG_T* p_config, unsigned speed)
+{
+	if ( speed == p_config->printSpeed ) {
+		return EPTMD_SUCCESS;
+	}
+	
+	unsigned char Command[7] = { GS, '(', 'K', 2, 0, 50, 0 };
+	Command[6] = (unsigned char)speed;
+	int result = WriteData( Command, sizeof(Command) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+	
+	p_config->printSpeed = speed;
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Check if real-time commands can be disabled during graphics.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int CanDisableRealTimeCommand(EPTMS_CONFIG_T* p_config)
+{
+	if ( TmRealTimeCommandDisable != p_config->realTimeCommand ) {
+		return 0;
+	}
+	
+	return p_config->realTimeSwitch;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Enable or disable real-time commands. (GS ( D : DLE DC4 <fn 1> and <fn 2>)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int EnableRealTimeCommand(EPTMS_CONFIG_T* p_config, int enable)
+{
+	if ( (0 != enable) == (0 == p_config->realTimeDisabled) ) {
+		return EPTMD_SUCCESS;
+	}
+	
+	unsigned char Command[10] = { GS, '(', 'D', 5, 0, 20, 1, 0, 2, 0 };
+	Command[7] = (0 != enable) ? 1 : 0;
+	Command[9] = (0 != enable) ? 1 : 0;
+	int result = WriteData( Command, sizeof(Command) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+	
+	p_config->realTimeDisabled = (0 != enable) ? 0 : 1;
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Find black-raster-line top.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static unsigned FindBlackRasterLineTop(cups_page_header_t* p_header, unsigned char* p_pageBuffer)
+{
+	unsigned       BytesPerLine = EPTMD_BITS_TO_BYTES( p_header->cupsWidth );
+	unsigned char* p_data = p_pageBuffer;
+	
+	unsigned y;
+	for ( y = 0; y < p_header->cupsHeight; y++ ) {
+		unsigned x;
+		for ( x = 0 ; x < BytesPerLine; x++ ) {
+			if ( 0x00 != p_data[x] ) {
+				return y;
+			}
+		}
+		p_data += BytesPerLine;
+	}
+	
+	return p_header->cupsHeight;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Find black-raster-line end.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static unsigned FindBlackRasterLineEnd(cups_page_header_t* p_header, unsigned char* p_pageBuffer)
+{
+	unsigned       BytesPerLine = EPTMD_BITS_TO_BYTES( p_header->cupsWidth );
+	unsigned char* p_data = p_pageBuffer + (BytesPerLine * (p_header->cupsHeight - 1));
+	
+	unsigned y;
+	for ( y = 0; y < p_header->cupsHeight; y++ ) {
+		unsigned x;
+		for ( x = 0 ; x < BytesPerLine; x++ ) {
+			if ( 0x00 != p_data[x] ) {
+			  return (p_header->cupsHeight - 1 - y);
+			}
+		}
+		p_data -= BytesPerLine;
+	}
+	
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Band out.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int WriteBand(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, unsigned char *p_data, unsigned lines, unsigned h_scale, unsigned v_scale)
+{
+	int result = EPTMD_SUCCESS;
+	
+	unsigned char CommandSetAbsolutePrintPosition[4]= { ESC, '$', 0, 0 };
+	result = WriteData( CommandSetAbsolutePrintPosition, sizeof(CommandSetAbsolutePrintPosition) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+	
+	unsigned long  width   = p_header->cupsWidth;
+	unsigned char* p_send_data = NULL;
+	
+	// A band of doubled pixels (h_scale, v_scale) is sent at half size.
+	if ( (1 < h_scale) || (1 < v_scale) ) {
+		p_send_data = (unsigned char*)malloc( EPTMD_BITS_TO_BYTES( width ) * lines );
+	}
+	if ( NULL != p_send_data ) {
+		ShrinkBand( p_data, EPTMD_BITS_TO_BYTES( width ), lines, p_send_data, h_scale, v_scale );
+		
+		width = (width + h_scale - 1) / h_scale;
+		lines = lines / v_scale;
+		p_data = p_send_data;
+		
+		// Avoid disturbing data (Shrinking can make new sequences.)
+		AvoidDisturbingData( p_data, EPTMD_BITS_TO_BYTES( width ) * lines, p_config->realTimeDisabled );
+	}
+	else {
+		h_scale = 1;
+		v_scale = 1;
+	}
+	h_scale *= p_config->h_magnification;
+	v_scale *= p_config->v_magnification;
+	
+	switch ( p_config->capability.graphicsCommand )
+	{
+		case TmGraphicsBitImage:
+			result = WriteBitImage( width, p_data, lines, h_scale, v_scale );
+			break;
+		
+		default:
+			result = WriteRasterGraphics( width, p_data, lines, h_scale, v_scale );
+			break;
+	}
+	
+	if ( NULL != p_send_data ) { free( p_send_data ); }
+	
+	return result;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Band out with GS 8 L <Function 112>.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int WriteRasterGraphics(unsigned long width, unsigned char *p_data, unsigned lines, unsigned h_scale, unsigned v_scale)
+{
+	int result = EPTMD_SUCCESS;
+	
+	unsigned char CommandSetGraphicsdataGS8L112[17] = { GS, '8', 'L', 0, 0, 0, 0, 48, 112, 48, 1, 1, 49, 0, 0, 0, 0 };
+	CommandSetGraphicsdataGS8L112[3]  = (unsigned char)(((EPTMD_BITS_TO_BYTES(width) * lines) + 10)      ) & 0xff;
+	CommandSetGraphicsdataGS8L112[4]  = (unsigned char)(((EPTMD_BITS_TO_BYTES(width) * lines) + 10) >>  8) & 0xff;
+	CommandSetGraphicsdataGS8L112[5]  = (unsigned char)(((EPTMD_BITS_TO_BYTES(width) * lines) + 10) >> 16) & 0xff;
+	CommandSetGraphicsdataGS8L112[6]  = (unsigned char)(((EPTMD_BITS_TO_BYTES(width) * lines) + 10) >> 24) & 0xff;
+	CommandSetGraphicsdataGS8L112[10] = (unsigned char)h_scale;
+	CommandSetGraphicsdataGS8L112[11] = (unsigned char)v_scale;
+	CommandSetGraphicsdataGS8L112[13] = (unsigned char)((width     ) & 0xff);
+	CommandSetGraphicsdataGS8L112[14] = (unsigned char)((width >> 8) & 0xff);
+	CommandSetGraphicsdataGS8L112[15] = (unsigned char)((lines     ) & 0xff);
+	CommandSetGraphicsdataGS8L112[16] = (unsigned char)((lines >> 8) & 0xff);
+	result = WriteData( CommandSetGraphicsdataGS8L112, sizeof(CommandSetGraphicsdataGS8L112) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+    result = WriteData( p_data, (unsigned int)(EPTMD_BITS_TO_BYTES(width) * lines) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+	
+	unsigned char CommandSetGraphicsdataGSpL50[7] = { GS, '(', 'L', 2, 0, 48, 50 };
+	result = WriteData( CommandSetGraphicsdataGSpL50, sizeof(CommandSetGraphicsdataGSpL50) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Band out with GS v 0. (for printers without GS 8 L)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int WriteBitImage(unsigned long width, unsigned char *p_data, unsigned lines, unsigned h_scale, unsigned v_scale)
+{
+	int result = EPTMD_SUCCESS;
+	
+	unsigned long width_bytes = EPTMD_BITS_TO_BYTES( width );
+	unsigned char CommandPrintRasterBitImage[8] = { GS, 'v', '0', 0, 0, 0, 0, 0 };
+	CommandPrintRasterBitImage[3] = (unsigned char)(((1 < h_scale) ? 1 : 0) | ((1 < v_scale) ? 2 : 0)); // double width / height
+	CommandPrintRasterBitImage[4] = (unsigned char)((width_bytes     ) & 0xff);
+	CommandPrintRasterBitImage[5] = (unsigned char)((width_bytes >> 8) & 0xff);
+	CommandPrintRasterBitImage[6] = (unsigned char)((lines     ) & 0xff);
+	CommandPrintRasterBitImage[7] = (unsigned char)((lines >> 8) & 0xff);
+	result = WriteData( CommandPrintRasterBitImage, sizeof(CommandPrintRasterBitImage) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+	result = WriteData( p_data, (unsigned int)(width_bytes * lines) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Find exact pixel doubling of a band.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static void FindMagnification(unsigned char* p_data, unsigned BytesPerLine, unsigned lines, unsigned* p_h_scale, unsigned* p_v_scale)
+{
+	int h_double = 1;	// Each pair of dots in a line is the same.
+	int v_double = (0 == (lines % 2)) ? 1 : 0;	// Each pair of lines is the same.
+	
+	unsigned y;
+	for ( y = 0; (y < lines) && (h_double || v_double); y++ ) {
+		unsigned char* p_line = p_data + ((unsigned long)BytesPerLine * y);
+		
+		if ( h_double ) {
+			unsigned x;
+			for ( x = 0; x < BytesPerLine; x++ ) {
+				if ( 0 != ((p_line[x] ^ (p_line[x] << 1)) & 0xAA) ) {
+					h_double = 0;
+					break;
+				}
+			}
+		}
+		if ( v_double && (1 == (y % 2)) ) {
+			if ( 0 != memcmp( p_line - BytesPerLine, p_line, BytesPerLine ) ) {
+				v_double = 0;
+			}
+		}
+	}
+	
+	*p_h_scale = h_double ? 2 : 1;
+	*p_v_scale = v_double ? 2 : 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Shrink a band of doubled pixels to half size.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static void ShrinkBand(unsigned char* p_data, unsigned BytesPerLine, unsigned lines, unsigned char* p_dest, unsigned h_scale, unsigned v_scale)
+{
+	unsigned DestBytesPerLine = (2 == h_scale) ? ((BytesPerLine + 1) / 2) : BytesPerLine;
+	
+	unsigned y;
+	for ( y = 0; y < lines; y += v_scale ) {
+		unsigned char* p_src = p_data + ((unsigned long)BytesPerLine * y);
+		
+		if ( 2 == h_scale ) {
+			unsigned x;
+			for ( x = 0; x < DestBytesPerLine; x++ ) {
+				unsigned char upper = p_src[x*2];
+				unsigned char lower = ((x*2 + 1) < BytesPerLine) ? p_src[x*2 + 1] : 0x00;
+				
+				// bit 7,5,3,1 of each byte are 4 dots of the half size line.
+				p_dest[x] = (unsigned char)( (((upper >> 4) & 0x08) | ((upper >> 3) & 0x04) | ((upper >> 2) & 0x02) | ((upper >> 1) & 0x01)) << 4 )
+						  | (unsigned char)( (((lower >> 4) & 0x08) | ((lower >> 3) & 0x04) | ((lower >> 2) & 0x02) | ((lower >> 1) & 0x01))      );
+			}
+		}
+		else {
+			memcpy( p_dest, p_src, BytesPerLine );
+		}
+		p_dest += DestBytesPerLine;
+	}
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get magnification from motion unit and raster resolution.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static unsigned GetMagnification(unsigned motionUnit, unsigned resolution)
+{
+	if ( 0 == resolution ) {
+		return 1;
+	}
+	
+	unsigned magnification = (motionUnit + (resolution / 2)) / resolution;	// 203 / 101 -> 2
+	if ( 2 < magnification ) {
+		magnification = 2;	// GS 8 L / GS v 0 specification
+	}
+	if ( 1 > magnification ) {
+		magnification = 1;
+	}
+	
+	return magnification;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get printer capabilities.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int GetCapability(EPTMS_CONFIG_T* p_config)
+{
+	// The result is kept in : /var/lib/tmx-cups/<printer>_Capability.dat
+	// A printer that does not answer is recorded too, and is probed again after EPTMD_PROBE_INTERVAL.
+	// (A printer that is still busy with the previous job may miss the timeout.) Remove the file to probe again.
+	
+	EPTMS_CAPABILITY_T capability = { 0 };
+	
+	if ( EPTMD_SUCCESS == ReadCapabilityFile( p_config->p_printerName, &capability ) ) {
+		if ( (0 != capability.probed) || (EPTMD_PROBE_INTERVAL >= ((long)time( NULL ) - capability.time)) ) {
+			p_config->capability = capability;
+			return (0 != capability.probed) ? EPTMD_SUCCESS : EPTMD_FAILED;
+		}
+		memset( &capability, 0, sizeof(capability) );
+	}
+	
+	int result = ProbeCapability( &capability );
+	if ( EPTMD_SUCCESS != result ) {
+		fprintf( stderr, "DEBUG: Printer capabilities are not available. Error Code=%d\n", result );
+		DrainBackChannel( EPTMD_DRAIN_TIMEOUT ); // Late responses must not be read as status.
+		
+		memset( &capability, 0, sizeof(capability) );
+		capability.time = (long)time( NULL );
+		if ( EPTMD_SUCCESS != WriteCapabilityFile( p_config->p_printerName, &capability ) ) {
+			fprintf( stderr, "DEBUG: Printer capabilities are not cached.\n" );
+		}
+		return result;
+	}
+	DrainBackChannel( 0.0 );
+	
+	p_config->capability = capability;
+	
+	if ( EPTMD_SUCCESS != WriteCapabilityFile( p_config->p_printerName, &capability ) ) {
+		fprintf( stderr, "DEBUG: Printer capabilities are not cached.\n" );
+	}
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Probe printer capabilities over the backchannel.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int ProbeCapability(EPTMS_CAPABILITY_T* p_capability)
+{
+	int result = EPTMD_SUCCESS;
+	
+	{ // Model ID
+		unsigned char Command[3] = { GS, 'I', 1 };
+		result = WriteData( Command, sizeof(Command) );
+		if ( EPTMD_SUCCESS != result ) { return 5001; }
+		
+		unsigned char data = 0;
+		do {
+			if ( 1 != ReadBackChannel( &data, EPTMD_PROBE_TIMEOUT ) ) { return 5002; }
+		} while ( 0x12 == (data & 0x93) ); // Skip status (ASB and DLE EOT : bits 1 and 4 are 1, bits 0 and 7 are 0)
+		
+		p_capability->modelId = data;
+	}
+	{ // Model name
+		unsigned char Command[3] = { GS, 'I', 67 };
+		result = WriteData( Command, sizeof(Command) );
+		if ( EPTMD_SUCCESS != result ) { return 5003; }
+		
+		unsigned char data[sizeof(p_capability->modelName)] = { 0 };
+		if ( 0 > ReadResponse( '_', data, sizeof(data) ) ) { return 5004; }
+		
+		memcpy( p_capability->modelName, data, sizeof(p_capability->modelName) );
+		p_capability->modelName[sizeof(p_capability->modelName) - 1] = '\0';
+	}
+	{ // Remaining capacity of the download graphics memory
+		// GS I 1 is sent behind GS ( L. If the model ID comes back without a GS ( L response before it,
+		// the printer has processed GS ( L and does not support it. A timeout tells nothing and fails the probe.
+		unsigned char Command[7+3] = { GS, '(', 'L', 2, 0, 48, 52, GS, 'I', 1 };
+		result = WriteData( Command, sizeof(Command) );
+		if ( EPTMD_SUCCESS != result ) { return 5005; }
+		
+		p_capability->bufferCapacity  = 0;
+		p_capability->graphicsCommand = TmGraphicsBitImage;
+		
+		unsigned char data = 0;
+		while ( 1 )
+		{
+			if ( 1 != ReadBackChannel( &data, EPTMD_PROBE_TIMEOUT ) ) { return 5006; }
+			if ( 0x37 == data ) { // 37h 34h <capacity> 00h
+				unsigned char block[16] = { 0 };
+				int size = 0;
+				do {
+					if ( 1 != ReadBackChannel( &data, EPTMD_PROBE_TIMEOUT ) ) { return 5006; }
+					if ( ((int)sizeof(block) - 1) > size ) {
+						block[size++] = data;
+					}
+				} while ( 0x00 != data );
+				
+				p_capability->bufferCapacity  = strtoul( (char*)&block[1], NULL, 10 ); // block[0] is the identifier.
+				p_capability->graphicsCommand = TmGraphicsRaster;
+			}
+			else if ( p_capability->modelId == data ) {
+				break;
+			}
+			else {} // Skip status
+		}
+	}
+	
+	p_capability->probed = 1;
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read capability file.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int ReadCapabilityFile(char *p_printerName, EPTMS_CAPABILITY_T* p_capability)
+{
+	char path[512 + 1];
+	snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, "Capability.dat" );
+	
+	FILE* fp = fopen( path, "r" );
+	if ( NULL == fp ) {
+		return EPTMD_FAILED;
+	}
+	
+	int  found = 0;
+	char line[128];
+	while ( NULL != fgets( line, sizeof(line), fp ) ) {
+		unsigned long value = 0;
+		long          seconds = 0;
+		char          name[64] = { 0 };
+		
+		if ( 1 == sscanf( line, "Probed=%lu", &value ) ) {
+			p_capability->probed = (0 != value) ? 1 : 0;
+			found++;
+		}
+		else if ( 1 == sscanf( line, "ModelId=%lu", &value ) ) {
+			p_capability->modelId = (unsigned)value;
+		}
+		else if ( 1 == sscanf( line, "ModelName=%63[^\n]", name ) ) {
+			memcpy( p_capability->modelName, name, sizeof(p_capability->modelName) );
+		}
+		else if ( 1 == sscanf( line, "BufferCapacity=%lu", &value ) ) {
+			p_capability->bufferCapacity = value;
+		}
+		else if ( 1 == sscanf( line, "GraphicsCommand=%lu", &value ) ) {
+			p_capability->graphicsCommand = (TmGraphicsBitImage == value) ? TmGraphicsBitImage : TmGraphicsRaster;
+			found++;
+		}
+		else if ( 1 == sscanf( line, "Time=%ld", &seconds ) ) {
+			p_capability->time = seconds;
+		}
+		else {}
+	}
+	fclose( fp );
+	
+	if ( 2 != found ) {
+		return EPTMD_FAILED;
+	}
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Write capability file.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int WriteCapabilityFile(char *p_printerName, EPTMS_CAPABILITY_T* p_capability)
+{
+	char path[512 + 1];
+	snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, "Capability.dat" );
+	
+	FILE* fp = fopen( path, "w" );
+	if ( NULL == fp ) {
+		return EPTMD_FAILED;
+	}
+	
+	fprintf( fp, "Probed=%d\n",          p_capability->probed          );
+	fprintf( fp, "ModelId=%u\n",         p_capability->modelId         );
+	fprintf( fp, "ModelName=%s\n",       p_capability->modelName       );
+	fprintf( fp, "BufferCapacity=%lu\n", p_capability->bufferCapacity  );
+	fprintf( fp, "GraphicsCommand=%d\n", p_capability->graphicsCommand );
+	fprintf( fp, "Time=%ld\n",            p_capability->time            );
+	
+	if ( 0 != fclose( fp ) ) {
+		unlink( path );
+		return EPTMD_FAILED;
+	}
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read a response block (header, data, NUL) from the backchannel.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int ReadResponse(unsigned char header, unsigned char* p_buffer, int buffer_size)
+{
+	unsigned char data = 0;
+	
+	do { // Skip until header
+		if ( 1 != ReadBackChannel( &data, EPTMD_PROBE_TIMEOUT ) ) { return EPTMD_FAILED; }
+	} while ( header != data );
+	
+	int size = 0;
+	while ( 1 )
+	{
+		if ( 1 != ReadBackChannel( &data, EPTMD_PROBE_TIMEOUT ) ) { return EPTMD_FAILED; }
+		if ( 0x00 == data ) {
+			break;
+		}
+		if ( (buffer_size - 1) > size ) {
+			p_buffer[size++] = data;
+		}
+	}
+	p_buffer[size] = 0x00;
+	
+	return size;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read one byte from the backchannel.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int ReadBackChannel(unsigned char* p_data, double timeout)
+{
+	ssize_t size = cupsBackChannelRead( (char*)p_data, 1, timeout );
+	
+	return (1 == size) ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Discard the backchannel data until it is silent for the timeout.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static void DrainBackChannel(double timeout)
+{
+	unsigned char data = 0;
+	
+	while ( 1 == ReadBackChannel( &data, timeout ) ) {}
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Initialize printer. (Only the changed settings if the previous job left the printer initialized)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int InitPrinter(EPTMS_CONFIG_T* p_config)
+{
+	// The state is kept in : /var/lib/tmx-cups/<printer>_State.dat
+	// It is removed while a job is running, so that a failed or canceled job leaves no state.
+	
+	EPTMS_PRINTER_STATE_T* p_state = &p_config->state;
+	EPTMS_PRINTER_STATE_T  previous = { 0 };
+	int result = EPTMD_SUCCESS;
+	int reuse = 0;
+	
+	memset( p_state, 0, sizeof(*p_state) );
+	
+	if ( EPTMD_SUCCESS != ReadStateFile( p_config->p_printerName, &previous ) ) {
+		memset( &previous, 0, sizeof(previous) );
+	}
+	
+	if ( (0 != p_config->capability.probed) && (EPTMD_SUCCESS == GetPrinterStatus( p_state->status )) ) {
+		if ( (0 != previous.initialized)
+		  && (0 != IsPrinterStatus( previous.status ))
+		  && (0 == memcmp( previous.status, p_state->status, sizeof(p_state->status) ))
+		  && ((long)time( NULL ) >= previous.time)
+		  && (EPTMD_STATE_LIFETIME >= ((long)time( NULL ) - previous.time))
+		  && (0 == HasUserFile( p_config->p_printerName )) ) {
+			reuse = 1;
+		}
+	}
+	RemoveStateFile( p_config->p_printerName );
+	
+	fprintf( stderr, "DEBUG: Printer initialization = %s\n", (0 != reuse) ? "skipped" : "full" );
+	
+	if ( (0 == reuse) && (0 != previous.cutReserved) ) { // Cut the previous job before ESC @ clears the reservation.
+		unsigned char CommandCut[3+4] = { ESC, 'J', 0, GS, 'V', 66, 0 };
+		result = WriteData( CommandCut, sizeof(CommandCut) );
+		if ( EPTMD_SUCCESS != result ) { return 2109; }
+	}
+	
+	if ( 0 == reuse ) {
+		unsigned char CommandInitialize[2] = { ESC, '@' };
+		result = WriteData( CommandInitialize, sizeof(CommandInitialize) );
+		if ( EPTMD_SUCCESS != result ) { return 2101; }
+		
+		unsigned char CommandSetPrintSheet[4] = { ESC, 'c', '0', 0x02 };
+		result = WriteData( CommandSetPrintSheet, sizeof(CommandSetPrintSheet) );
+		if ( EPTMD_SUCCESS != result ) { return 2102; }
+		
+		unsigned char CommandSetConfigSheet[4] = { ESC, 'c', '1', 0x02 };
+		result = WriteData( CommandSetConfigSheet, sizeof(CommandSetConfigSheet) );
+		if ( EPTMD_SUCCESS != result ) { return 2103; }
+		
+		unsigned char CommandSetNearendPrint[4] = { ESC, 'c', '3', 0x00 };
+		result = WriteData( CommandSetNearendPrint, sizeof(CommandSetNearendPrint) );
+		if ( EPTMD_SUCCESS != result ) { return 2104; }
+	}
+	
+	if ( (0 == reuse) || (previous.h_motionUnit != p_config->h_motionUnit) || (previous.v_motionUnit != p_config->v_motionUnit) ) {
+		unsigned char CommandSetBaseMotionUnit[4] = { GS, 'P', 0x00, 0x00 };
+		CommandSetBaseMotionUnit[2] = p_config->h_motionUnit;
+		CommandSetBaseMotionUnit[3] = p_config->v_motionUnit;
+		result = WriteData( CommandSetBaseMotionUnit, sizeof(CommandSetBaseMotionUnit) );
+		if ( EPTMD_SUCCESS != result ) { return 2105; }
+	}
+	
+	p_state->initialized  = 1;
+	p_state->h_motionUnit = p_config->h_motionUnit;
+	p_state->v_motionUnit = p_config->v_motionUnit;
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get printer status. (DLE EOT <n = 1 to 4>)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int GetPrinterStatus(unsigned char* p_status)
+{
+	DrainBackChannel( 0.0 ); // Replies of earlier commands must not be read as status.
+	
+	unsigned char n;
+	for ( n = 1; EPTMD_STATUS_COUNT >= n; n++ ) {
+		unsigned char Command[3] = { DLE, 0x04, n };
+		if ( EPTMD_SUCCESS != WriteData( Command, sizeof(Command) ) ) {
+			return EPTMD_FAILED;
+		}
+		
+		unsigned char data = 0;
+		if ( 1 != ReadBackChannel( &data, EPTMD_PROBE_TIMEOUT ) ) { return EPTMD_FAILED; }
+		
+		p_status[n - 1] = data;
+	}
+	
+	return (0 != IsPrinterStatus( p_status )) ? EPTMD_SUCCESS : EPTMD_FAILED;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Check if the bytes look like printer status. (0xx1xx10b : a stray reply does not)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int IsPrinterStatus(unsigned char* p_status)
+{
+	unsigned i;
+	for ( i = 0; EPTMD_STATUS_COUNT > i; i++ ) {
+		if ( 0x12 != (p_status[i] & 0x93) ) {
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Check if user-files exist. (They may change the printer settings.)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int HasUserFile(char *p_printerName)
+{
+	char* p_file_names[] = { "StartJob.prn", "StartPage.prn", "EndPage.prn", "EndJob.prn" };
+	
+	unsigned i;
+	for ( i = 0; (sizeof(p_file_names) / sizeof(p_file_names[0])) > i; i++ ) {
+		char path[512 + 1];
+		snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, p_file_names[i] );
+		
+		if ( 0 == access( path, F_OK ) ) {
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read printer state file.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int ReadStateFile(char *p_printerName, EPTMS_PRINTER_STATE_T* p_state)
+{
+	char path[512 + 1];
+	snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, "State.dat" );
+	
+	FILE* fp = fopen( path, "r" );
+	if ( NULL == fp ) {
+		return EPTMD_FAILED;
+	}
+	
+	int  found = 0;
+	char line[128];
+	while ( NULL != fgets( line, sizeof(line), fp ) ) {
+		unsigned long value = 0;
+		unsigned      status[EPTMD_STATUS_COUNT] = { 0 };
+		long          seconds = 0;
+		
+		if ( 1 == sscanf( line, "Initialized=%lu", &value ) ) {
+			p_state->initialized = (0 != value) ? 1 : 0;
+			found++;
+		}
+		else if ( 1 == sscanf( line, "MotionUnitHori=%lu", &value ) ) {
+			p_state->h_motionUnit = (unsigned)value;
+		}
+		else if ( 1 == sscanf( line, "MotionUnitVert=%lu", &value ) ) {
+			p_state->v_motionUnit = (unsigned)value;
+		}
+		else if ( EPTMD_STATUS_COUNT == sscanf( line, "Status=%02x%02x%02x%02x", &status[0], &status[1], &status[2], &status[3] ) ) {
+			unsigned i;
+			for ( i = 0; EPTMD_STATUS_COUNT > i; i++ ) {
+				p_state->status[i] = (unsigned char)status[i];
+			}
+			found++;
+		}
+		else if ( 1 == sscanf( line, "CutReserved=%lu", &value ) ) {
+			p_state->cutReserved = (0 != value) ? 1 : 0;
+		}
+		else if ( 1 == sscanf( line, "Time=%ld", &seconds ) ) {
+			p_state->time = seconds;
+			found++;
+		}
+		else {}
+	}
+	fclose( fp );
+	
+	if ( 3 != found ) {
+		return EPTMD_FAILED;
 	}
 	
 	return EPTMD_SUCCESS;
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * Read raster data of one page.
+ * Write printer state file.
  *-------------------------------------------------------------------------------------------------------------------*/
-static int ReadRaster(cups_page_header_t* p_header, cups_raster_t* p_raster, unsigned char* p_pageBuffer)
+static int WriteStateFile(char *p_printerName, EPTMS_PRINTER_STATE_T* p_state)
 {
-	int				result = EPTMD_SUCCESS;
-	unsigned char*	p_data;
-	unsigned		data_size = p_header->cupsBytesPerLine;
+	char path[512 + 1];
+	snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, "State.dat" );
 	
-	p_data = (unsigned char*)malloc( data_size );
-	if ( NULL == p_data ) {
-		return 3301;
+	FILE* fp = fopen( path, "w" );
+	if ( NULL == fp ) {
+		return EPTMD_FAILED;
 	}
-	memset( p_data, 0, data_size );
 	
-	unsigned i;
-	for ( i = 0; i < p_header->cupsHeight; i++ ) {
-		if ( 0 != g_TmCanceled ) {
-			result = EPTMD_CANCEL;
-			break;
-		}
-		
-		unsigned num_bytes_read = cupsRasterReadPixels( p_raster, p_data, data_size );
-		if ( data_size > num_bytes_read ) {
-			fprintf( stderr, "DEBUG: cupsRasterReadPixels() = %u:%u/%u\n", (i + 1), num_bytes_read, data_size );
-			result = 3302;
-			break;
-		}
-		
-		TransferRaster( p_pageBuffer, p_data, p_header, i );
-	}
+	fprintf( fp, "Initialized=%d\n",    p_state->initialized  );
+	fprintf( fp, "MotionUnitHori=%u\n", p_state->h_motionUnit );
+	fprintf( fp, "MotionUnitVert=%u\n", p_state->v_motionUnit );
+	fprintf( fp, "Status=%02x%02x%02x%02x\n", p_state->status[0], p_state->status[1], p_state->status[2], p_state->status[3] );
+	fprintf( fp, "CutReserved=%d\n",    p_state->cutReserved  );
+	fprintf( fp, "Time=%ld\n",          p_state->time         );
 	
-	free( p_data );
+	if ( 0 != fclose( fp ) ) {
+		unlink( path );
+		return EPTMD_FAILED;
+	}
 	
-	return result;
+	return EPTMD_SUCCESS;
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * Transfer raster to page buffer for 1bit per pixel data.
+ * Remove printer state file.
  *-------------------------------------------------------------------------------------------------------------------*/
-static void TransferRaster(unsigned char* p_pageBuffer, unsigned char *p_data, cups_page_header_t* p_header, unsigned line_no)
+static void RemoveStateFile(char *p_printerName)
 {
-	unsigned char*	p_dest   = p_pageBuffer + (EPTMD_BITS_TO_BYTES( p_header->cupsWidth ) * line_no );
+	char path[512 + 1];
+	snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, "State.dat" );
 	
-	memcpy( p_dest, p_data, p_header->cupsBytesPerLine );
+	unlink( path );
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * Write raster data of one page.
+ * Resume the job interrupted by an output failure. (From the first checkpoint not printed)
  *-------------------------------------------------------------------------------------------------------------------*/
-static int WriteRaster(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, unsigned char* p_pageBuffer)
+static void ResumeJob(EPTMS_CONFIG_T* p_config)
 {
-	unsigned 		line_no = 0;
-	unsigned 		start_line_no = 0;	/* first raster line without top blank */
-	unsigned 		last_line_no  = 0;	/* last raster line without bottom blank */
-	unsigned char*	p_data = NULL;
-	int				result = EPTMD_SUCCESS;
+	// The checkpoint is kept in : /var/lib/tmx-cups/<printer>_Checkpoint.dat
+	// It is removed when the job is completed. The checkpoint of another job or another band length is discarded.
 	
-	// Get top margin
-	start_line_no = FindBlackRasterLineTop( p_header, p_pageBuffer );
-	if( p_header->cupsHeight == start_line_no ) { /* This page has not image */
-		if ( TmPaperReductionOff == p_config->paperReduction ) {
-			result = FeedPaper( p_config, p_header, p_header->cupsHeight );
-			if ( EPTMD_SUCCESS != result ) { return 3401; }
-		}
-		return EPTMD_SUCCESS;
+	EPTMS_CHECKPOINT_T* p_checkpoint = &p_config->checkpoint;
+	int      jobId     = 0;
+	unsigned bandLines = 0;
+	unsigned printed   = 0;
+	
+	memset( p_checkpoint, 0, sizeof(*p_checkpoint) );
+	
+	if ( EPTMD_SUCCESS != ReadCheckpointFile( p_config->p_printerName, &jobId, &bandLines, &printed ) ) {
+		RemoveCheckpointFile( p_config->p_printerName );
+		return;
+	}
+	if ( (jobId != p_config->jobId) || (bandLines != p_config->maxBandLines) ) {
+		RemoveCheckpointFile( p_config->p_printerName );
+		return;
 	}
 	
-	// Get bottom margin
-	last_line_no = FindBlackRasterLineEnd( p_header, p_pageBuffer ) + 1;
+	p_checkpoint->resumed = printed;
+	p_checkpoint->printed = printed;
 	
-	// Avoid disturbing data
-	AvoidDisturbingData( p_header, p_pageBuffer, start_line_no, last_line_no );
+	fprintf( stderr, "INFO: Resuming job %d after checkpoint %u\n", jobId, printed );
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Clear the receive and print buffers of the printer. (DLE DC4 <Function 8>)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int ClearBuffer(EPTMS_CONFIG_T* p_config, int* p_answered)
+{
+	// The interrupted run may have left an incomplete command in the printer.
+	unsigned char Command[10] = { DLE, 0x14, 8, 1, 3, 20, 1, 6, 2, 8 };
+	int result = WriteData( Command, sizeof(Command) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
 	
-	// Command output : top margin
-	if ( !((TmPaperReductionTop == p_config->paperReduction) || (TmPaperReductionBoth == p_config->paperReduction)) ) {
-		result = FeedPaper( p_config, p_header, start_line_no );
-		if ( EPTMD_SUCCESS != result ) { return 3402; }
+	// The response must be read before the printer is probed. (Not waited for if the printer is known not to answer)
+	EPTMS_CAPABILITY_T capability = { 0 };
+	if ( (EPTMD_SUCCESS == ReadCapabilityFile( p_config->p_printerName, &capability )) && (0 == capability.probed) ) {
+		*p_answered = 0;
+		return EPTMD_SUCCESS;
 	}
-	// Command output : raster data (band unit)
-	for ( line_no = start_line_no; (line_no + p_config->maxBandLines) < last_line_no; line_no+=p_config->maxBandLines ) {
-		p_data = p_pageBuffer + (EPTMD_BITS_TO_BYTES( p_header->cupsWidth ) * line_no);
-		result = WriteBand( p_header, p_data, p_config->maxBandLines );
-		if ( EPTMD_SUCCESS != result ) { return 3403; }
-		
-		if ( 0 != g_TmCanceled ) {
-			return EPTMD_CANCEL;
+	
+	unsigned char data[8] = { 0 };
+	do { // Late process ID responses of the interrupted run are skipped.
+		if ( 0 > ReadResponse( 0x37, data, sizeof(data) ) ) { // 37h 25h 00h
+			fprintf( stderr, "DEBUG: Buffer clear is not answered.\n" );
+			*p_answered = 0;
+			break;
 		}
-	}
-	// Command output : raster data
-	if ( line_no < last_line_no ) {
-		p_data = p_pageBuffer + (EPTMD_BITS_TO_BYTES( p_header->cupsWidth ) * line_no);
-		result = WriteBand( p_header, p_data, (last_line_no - line_no) );
-		if ( EPTMD_SUCCESS != result ) { return 3404; }
-	}
-	// Command output : Bottom margin
-	if ( !((TmPaperReductionBottom == p_config->paperReduction) || (TmPaperReductionBoth == p_config->paperReduction)) ) {
-		result = FeedPaper( p_config, p_header, (p_header->cupsHeight - last_line_no) );
-		if ( EPTMD_SUCCESS != result ) { return 3405; }
-	}
+	} while ( 0x25 != data[0] );
 	
 	return EPTMD_SUCCESS;
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * Avoid disturbing data.
+ * Check if the printed position can be tracked with process IDs.
  *-------------------------------------------------------------------------------------------------------------------*/
-static void AvoidDisturbingData(cups_page_header_t* p_header, unsigned char* p_pageBuffer, unsigned start_line_no, unsigned last_line_no)
+static int CanTrackCheckpoint(EPTMS_CONFIG_T* p_config)
 {
-	unsigned char*	p_data = p_pageBuffer + (EPTMD_BITS_TO_BYTES( p_header->cupsWidth ) * start_line_no);
-	unsigned long	data_size = (last_line_no - start_line_no) * EPTMD_BITS_TO_BYTES( p_header->cupsWidth );
-	
-    unsigned long i = 0;
-	for ( ; (i + 1) < data_size; i++ ) {
-		if ( 0x10 == p_data[i] ) {
-			if ( (0x04 == p_data[i+1]) || (0x05 == p_data[i+1]) || (0x14 == p_data[i+1]) ) {
-				p_data[i] = 0x30;
-			}
-		}
-		else if ( 0x1B == p_data[i] ) {
-			if ( 0x3D == p_data[i+1] ) {
-				p_data[i] = 0x3B;
-			}
-		}
-		else {}
+	if ( TmResumeBand != p_config->resume ) {
+		return 0;
 	}
+	
+	// Printers answering GS ( L <Function 52> also support GS ( H.
+	return ((0 != p_config->capability.probed) && (TmGraphicsRaster == p_config->capability.graphicsCommand)) ? 1 : 0;
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * Find black-raster-line top.
+ * Check if the data up to the next checkpoint was printed before the job was interrupted.
  *-------------------------------------------------------------------------------------------------------------------*/
-static unsigned FindBlackRasterLineTop(cups_page_header_t* p_header, unsigned char* p_pageBuffer)
+static int IsPrinted(EPTMS_CONFIG_T* p_config)
 {
-	unsigned       BytesPerLine = EPTMD_BITS_TO_BYTES( p_header->cupsWidth );
-	unsigned char* p_data = p_pageBuffer;
+	return (p_config->checkpoint.resumed > p_config->checkpoint.sequence) ? 1 : 0;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Pass a checkpoint. (GS ( H <Function 48> : The process ID is answered when the data before it is printed.)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int PassCheckpoint(EPTMS_CONFIG_T* p_config)
+{
+	EPTMS_CHECKPOINT_T* p_checkpoint = &p_config->checkpoint;
 	
-	unsigned y;
-	for ( y = 0; y < p_header->cupsHeight; y++ ) {
-		unsigned x;
-		for ( x = 0 ; x < BytesPerLine; x++ ) {
-			if ( 0x00 != p_data[x] ) {
-				return y;
+	p_checkpoint->sequence++;
+	
+	if ( p_checkpoint->resumed >= p_checkpoint->sequence ) { // Printed before the job was interrupted.
+		return EPTMD_SUCCESS;
+	}
+	if ( (0 == p_checkpoint->enabled) || (EPTMD_MAX_CHECKPOINT < p_checkpoint->sequence) ) {
+		return EPTMD_SUCCESS;
+	}
+	
+	unsigned char Command[11] = { GS, '(', 'H', 6, 0, 48, 48, '0', '0', '0', '0' };
+	unsigned n = p_checkpoint->sequence;
+	int i;
+	for ( i = 10; 7 <= i; i-- ) {
+		Command[i] = (unsigned char)('0' + (n % 10));
+		n /= 10;
+	}
+	int result = WriteData( Command, sizeof(Command) );
+	if ( EPTMD_SUCCESS != result ) { return result; }
+	
+	ReadCheckpoint( p_config, 0.0 );
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Read process ID responses, and record the last checkpoint printed. (Waits up to the timeout in total until it is answered.)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static void ReadCheckpoint(EPTMS_CONFIG_T* p_config, double timeout)
+{
+	EPTMS_CHECKPOINT_T* p_checkpoint = &p_config->checkpoint;
+	unsigned            printed = p_checkpoint->printed;
+	unsigned            last = (EPTMD_MAX_CHECKPOINT < p_checkpoint->sequence) ? EPTMD_MAX_CHECKPOINT : p_checkpoint->sequence;
+	double              limit = GetTime() + timeout;
+	double              wait = timeout;
+	unsigned char       data = 0;
+	
+	while ( 1 == ReadBackChannel( &data, (last > printed) ? wait : 0.0 ) ) {
+		unsigned size  = p_checkpoint->responseSize;
+		int      valid = 0;
+		
+		wait = limit - GetTime();
+		if ( 0.0 > wait ) { // A negative timeout would wait forever.
+			wait = 0.0;
+		}
+		
+		if ( 0 == size ) {									// Header (Other responses and status are skipped.)
+			valid = (0x37 == data) ? 1 : 0;
+		}
+		else if ( 1 == size ) {								// Process ID response
+			valid = (0x22 == data) ? 1 : 0;
+		}
+		else if ( (EPTMD_PROCESS_ID_SIZE - 1) > size ) {	// d1 to d4
+			valid = (('0' <= data) && ('9' >= data)) ? 1 : 0;
+		}
+		else {												// NUL
+			valid = (0x00 == data) ? 1 : 0;
+		}
+		
+		if ( 0 == valid ) {
+			p_checkpoint->responseSize = (0x37 == data) ? 1 : 0;
+			continue;
+		}
+		p_checkpoint->response[size] = data;
+		p_checkpoint->responseSize++;
+		
+		if ( EPTMD_PROCESS_ID_SIZE == p_checkpoint->responseSize ) {
+			unsigned id = 0;
+			for ( size = 2; (EPTMD_PROCESS_ID_SIZE - 1) > size; size++ ) {
+				id = (id * 10) + (p_checkpoint->response[size] - '0');
 			}
+			if ( (printed < id) && (p_checkpoint->sequence >= id) ) {
+				printed = id;
+			}
+			p_checkpoint->responseSize = 0;
 		}
-		p_data += BytesPerLine;
 	}
 	
-	return p_header->cupsHeight;
+	if ( printed != p_checkpoint->printed ) {
+		p_checkpoint->printed = printed;
+		if ( EPTMD_SUCCESS != WriteCheckpointFile( p_config->p_printerName, p_config->jobId, p_config->maxBandLines, printed ) ) {
+			fprintf( stderr, "DEBUG: Checkpoint is not recorded.\n" );
+		}
+	}
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * Find black-raster-line end.
+ * Read checkpoint file.
  *-------------------------------------------------------------------------------------------------------------------*/
-static unsigned FindBlackRasterLineEnd(cups_page_header_t* p_header, unsigned char* p_pageBuffer)
+static int ReadCheckpointFile(char *p_printerName, int* p_jobId, unsigned* p_bandLines, unsigned* p_printed)
 {
-	unsigned       BytesPerLine = EPTMD_BITS_TO_BYTES( p_header->cupsWidth );
-	unsigned char* p_data = p_pageBuffer + (BytesPerLine * (p_header->cupsHeight - 1));
+	char path[512 + 1];
+	snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, "Checkpoint.dat" );
 	
-	unsigned y;
-	for ( y = 0; y < p_header->cupsHeight; y++ ) {
-		unsigned x;
-		for ( x = 0 ; x < BytesPerLine; x++ ) {
-			if ( 0x00 != p_data[x] ) {
-			  return (p_header->cupsHeight - 1 - y);
-			}
+	FILE* fp = fopen( path, "r" );
+	if ( NULL == fp ) {
+		return EPTMD_FAILED;
+	}
+	
+	int  found = 0;
+	char line[128];
+	while ( NULL != fgets( line, sizeof(line), fp ) ) {
+		unsigned long value = 0;
+		int           number = 0;
+		
+		if ( 1 == sscanf( line, "Job=%d", &number ) ) {
+			*p_jobId = number;
+			found++;
 		}
-		p_data -= BytesPerLine;
+		else if ( 1 == sscanf( line, "BandLines=%lu", &value ) ) {
+			*p_bandLines = (unsigned)value;
+			found++;
+		}
+		else if ( 1 == sscanf( line, "Checkpoint=%lu", &value ) ) {
+			*p_printed = (unsigned)value;
+			found++;
+		}
+		else {}
 	}
+	fclose( fp );
 	
-	return 0;
+	if ( 3 != found ) {
+		return EPTMD_FAILED;
+	}
+	
+	return EPTMD_SUCCESS;
 }
 
 /*---------------------------------------------------------------------------------------------------------------------
- * Band out.
+ * Write checkpoint file.
  *-------------------------------------------------------------------------------------------------------------------*/
-static int WriteBand(cups_page_header_t* p_header, unsigned char *p_data, unsigned lines)
+static int WriteCheckpointFile(char *p_printerName, int jobId, unsigned bandLines, unsigned printed)
 {
-	int result = EPTMD_SUCCESS;
+	char path[512 + 1];
+	snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, "Checkpoint.dat" );
 	
-	unsigned char CommandSetAbsolutePrintPosition[4]= { ESC, '$', 0, 0 };
-	result = WriteData( CommandSetAbsolutePrintPosition, sizeof(CommandSetAbsolutePrintPosition) );
-	if ( EPTMD_SUCCESS != result ) { return result; }
+	FILE* fp = fopen( path, "w" );
+	if ( NULL == fp ) {
+		return EPTMD_FAILED;
+	}
 	
-	unsigned long width = p_header->cupsWidth;
-	unsigned char CommandSetGraphicsdataGS8L112[17] = { GS, '8', 'L', 0, 0, 0, 0, 48, 112, 48, 1, 1, 49, 0, 0, 0, 0 };
-	CommandSetGraphicsdataGS8L112[3]  = (unsigned char)(((EPTMD_BITS_TO_BYTES(width) * lines) + 10)      ) & 0xff;
-	CommandSetGraphicsdataGS8L112[4]  = (unsigned char)(((EPTMD_BITS_TO_BYTES(width) * lines) + 10) >>  8) & 0xff;
-	CommandSetGraphicsdataGS8L112[5]  = (unsigned char)(((EPTMD_BITS_TO_BYTES(width) * lines) + 10) >> 16) & 0xff;
-	CommandSetGraphicsdataGS8L112[6]  = (unsigned char)(((EPTMD_BITS_TO_BYTES(width) * lines) + 10) >> 24) & 0xff;
-	CommandSetGraphicsdataGS8L112[13] = (unsigned char)((width     ) & 0xff);
-	CommandSetGraphicsdataGS8L112[14] = (unsigned char)((width >> 8) & 0xff);
-	CommandSetGraphicsdataGS8L112[15] = (unsigned char)((lines     ) & 0xff);
-	CommandSetGraphicsdataGS8L112[16] = (unsigned char)((lines >> 8) & 0xff);
-	result = WriteData( CommandSetGraphicsdataGS8L112, sizeof(CommandSetGraphicsdataGS8L112) );
-	if ( EPTMD_SUCCESS != result ) { return result; }
-    result = WriteData( p_data, (unsigned int)(EPTMD_BITS_TO_BYTES(width) * lines) );
-	if ( EPTMD_SUCCESS != result ) { return result; }
+	fprintf( fp, "Job=%d\n",        jobId     );
+	fprintf( fp, "BandLines=%u\n",  bandLines );
+	fprintf( fp, "Checkpoint=%u\n", printed   );
 	
-	unsigned char CommandSetGraphicsdataGSpL50[7] = { GS, '(', 'L', 2, 0, 48, 50 };
-	result = WriteData( CommandSetGraphicsdataGSpL50, sizeof(CommandSetGraphicsdataGSpL50) );
-	if ( EPTMD_SUCCESS != result ) { return result; }
+	if ( 0 != fclose( fp ) ) {
+		unlink( path );
+		return EPTMD_FAILED;
+	}
 	
 	return EPTMD_SUCCESS;
 }
 
+/*---------------------------------------------------------------------------------------------------------------------
+ * Remove checkpoint file.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static void RemoveCheckpointFile(char *p_printerName)
+{
+	char path[512 + 1];
+	snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, "Checkpoint.dat" );
+	
+	unlink( path );
+}
+
 /*---------------------------------------------------------------------------------------------------------------------
  * Write user-file.
  *-------------------------------------------------------------------------------------------------------------------*/
@@ -942,11 +2699,7 @@ static int WriteUserFile(char *p_printerName, char *p_file_name)
 	// Output a file if it exists in a predetermined place. : /var/lib/tmx-cups
 	
 	char path[512 + 1];
-#ifndef EPD_TM_MAC
-	snprintf( path, sizeof(path)-1, "%s/%s_%s", "/var/lib/tmx-cups", p_printerName, p_file_name );
-#else
-    snprintf( path, sizeof(path)-1, "%s/%s_%s", "/Library/Caches/Epson/TerminalPrinter", p_printerName, p_file_name );
-#endif
+	snprintf( path, sizeof(path)-1, "%s/%s_%s", EPTMD_DATA_DIR, p_printerName, p_file_name );
 	
 	int fd = open( path, O_RDONLY );
 	if ( 0 > fd ) {
@@ -1017,7 +2770,17 @@ static int FeedPaper(EPTMS_CONFIG_T* p_config, cups_page_header_t* p_header, uns
 	unsigned		point = 0;
 	double			integral = 0.0;
 	
-	double correction = (double)(num_line * p_config->v_motionUnit) / (double)p_header->HWResolution[1];
+	if ( 0 == p_header->HWResolution[1] ) { // No page
+		return EPTMD_SUCCESS;
+	}
+	
+	// A magnified page is printed at the dot density of the printer, so feed it by the same magnification.
+	double resolution = (double)p_header->HWResolution[1];
+	if ( 1 < p_config->v_magnification ) {
+		resolution = (double)p_config->v_motionUnit / (double)p_config->v_magnification;
+	}
+	
+	double correction = (double)(num_line * p_config->v_motionUnit) / resolution;
 	double fractional = modf( correction, &integral );
 	if ( fractional == 0 ) {} // warning
 	
@@ -1051,7 +2814,11 @@ static int WriteData(unsigned char *p_buffer, unsigned int size)
 	
 	unsigned int count;
 	for ( count = 0; size > count; count += result ) {
-        result = (int)write( STDOUT_FILENO, (p_data + count), (size - count) );
+		if ( EPTMD_SUCCESS != WaitWritable() ) {
+			return -1;
+		}
+		unsigned int length = ((size - count) < EPTMD_WRITE_CHUNK) ? (size - count) : EPTMD_WRITE_CHUNK;
+        result = (int)write( STDOUT_FILENO, (p_data + count), length );
 		if ( 0 == result ) {
 			break;
 		}
@@ -1062,8 +2829,96 @@ static int WriteData(unsigned char *p_buffer, unsigned int size)
 			return -1;
 		}
 		else {}
+		g_TmProgress.bytes += result;
 	}
 	
 	return (count == size) ? EPTMD_SUCCESS : EPTMD_FAILED;
 }
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Wait until the output accepts data. (Warn if the printer stalls)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static int WaitWritable(void)
+{
+	struct pollfd fds = { STDOUT_FILENO, POLLOUT, 0 };
+	
+	for ( ; ; ) {
+		int result = poll( &fds, 1, (EPTMD_STALL_TIMEOUT * 1000) );
+		if ( 0 < result ) {
+			break;
+		}
+		else if ( 0 == result ) {
+			if ( 0 == g_TmProgress.stalled ) {
+				fprintf( stderr, "WARNING: Printer has not accepted data for %d seconds (%lu bytes sent)\n", EPTMD_STALL_TIMEOUT, g_TmProgress.bytes );
+				fprintf( stderr, "STATE: +other-warning\n" );
+			}
+			g_TmProgress.stalled++;
+		}
+		else if ( EINTR != errno ) {
+			return EPTMD_FAILED;
+		}
+		else {}
+	}
+	
+	if ( 0 != g_TmProgress.stalled ) {
+		fprintf( stderr, "INFO: Printer accepted data after %d seconds\n", (g_TmProgress.stalled * EPTMD_STALL_TIMEOUT) );
+		fprintf( stderr, "STATE: -other-warning\n" );
+		g_TmProgress.stalled = 0;
+	}
+	
+	return EPTMD_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Start progress of page.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static void StartProgress(unsigned page, unsigned lines)
+{
+	g_TmProgress.page = page;
+	g_TmProgress.pageLines = lines;
+	g_TmProgress.sentLines = 0;
+	g_TmProgress.bands = 0;
+	g_TmProgress.reportTime = GetTime();
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Report progress of page. (At most once per EPTMD_PROGRESS_INTERVAL unless forced)
+ *-------------------------------------------------------------------------------------------------------------------*/
+static void ReportProgress(unsigned lines, int force)
+{
+	g_TmProgress.sentLines += lines;
+	g_TmProgress.bands++;
+	
+	double now = GetTime();
+	if ( (0 == force) && (EPTMD_PROGRESS_INTERVAL > (now - g_TmProgress.reportTime)) ) {
+		return;
+	}
+	g_TmProgress.reportTime = now;
+	
+	unsigned percent = 100;
+	if ( 0 < g_TmProgress.pageLines ) {
+		percent = (unsigned)(((unsigned long)g_TmProgress.sentLines * 100) / g_TmProgress.pageLines);
+	}
+	double elapsed = now - g_TmProgress.startTime;
+	unsigned long rate = (0.0 < elapsed) ? (unsigned long)(g_TmProgress.bytes / elapsed) : 0;
+	
+	fprintf( stderr, "INFO: Page %u: %u/%u lines, %u bands, %lu bytes sent (%lu bytes/s), %u%%\n",
+			 g_TmProgress.page, g_TmProgress.sentLines, g_TmProgress.pageLines, g_TmProgress.bands,
+			 g_TmProgress.bytes, rate, percent );
+	fprintf( stderr, "ATTR: job-media-progress=%u\n", percent );
+}
+
+/*---------------------------------------------------------------------------------------------------------------------
+ * Get monotonic time in seconds.
+ *-------------------------------------------------------------------------------------------------------------------*/
+static double GetTime(void)
+{
+	struct timespec now;
+	
+	if ( 0 != clock_gettime( CLOCK_MONOTONIC, &now ) ) {
+		return 0.0;
+	}
+	
+	return (double)now.tv_sec + ((double)now.tv_nsec / 1000000000.0);
+}
 /*-------------------------------------------------------------------------------------------------------------------*/
@@ -71,6 +71,20 @@ echo "Installing filter driver ..."
 $INSTALL -s ./build/rastertotmtr $FILTERDIR
 echo ""
 
+echo "Creating data directory ..."
+CUPSUSER=$(grep '^User' /usr/local/etc/cups/cups-files.conf | awk '{print $2}')
+CUPSGROUP=$(grep '^Group' /usr/local/etc/cups/cups-files.conf | awk '{print $2}')
+if [ -z $CUPSUSER ]
+then
+    CUPSUSER=lp
+fi
+if [ -z $CUPSGROUP ]
+then
+    CUPSGROUP=lp
+fi
+$INSTALL -m 755 -o $CUPSUSER -g $CUPSGROUP -d /var/lib/tmx-cups
+echo ""
+
 echo "Installing ppd files ..."
 $INSTALL -m 755 -d $PPDDIR 
 $INSTALL -m 755 ./ppd/*.ppd $PPDDIR 
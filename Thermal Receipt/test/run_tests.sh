@@ -0,0 +1,18 @@
+#!/bin/sh
+# Builds the filter against the libcups stub (stub/) and runs the scripted printer tests.
+#   run_tests.sh [build directory]
+
+TESTDIR=$(cd "$(dirname "$0")" && pwd)
+BUILDDIR=${1:-$TESTDIR/build}
+CC=${CC:-cc}
+
+mkdir -p "$BUILDDIR/data" || exit 1
+BUILDDIR=$(cd "$BUILDDIR" && pwd)
+
+# The reserved cut watcher and the stall warning wait 1 s instead of 10 s.
+$CC -std=gnu99 -O2 -Wall -I"$TESTDIR/stub" -I"$TESTDIR/../../Common/filter" \
+    -DEPTMD_DATA_DIR="\"$BUILDDIR/data\"" -DEPTMD_RESERVED_CUT_TIMEOUT=1 -DEPTMD_STALL_TIMEOUT=1 \
+    -o "$BUILDDIR/rastertotmtr" "$TESTDIR/../filter/TmThermalReceipt.c" "$TESTDIR/../../Common/filter/TmRasterStream.c" \
+    "$TESTDIR/stub/libcups.c" -lm || exit 1
+
+cd "$TESTDIR" && TMX_BUILD_DIR="$BUILDDIR" python3 -m unittest discover -s "$TESTDIR" -p 'test_*.py' -v
@@ -0,0 +1,69 @@
+/*
+ * Minimal libcups declarations for the filter tests. (Only what the filter uses)
+ */
+#ifndef TMX_STUB_CUPS_H
+#define TMX_STUB_CUPS_H
+
+#include <stdio.h>
+#include <time.h>
+#include <sys/types.h>
+
+typedef struct {
+	char*			name;
+	char*			value;
+} cups_option_t;
+
+typedef struct _http_s http_t;
+
+#define CUPS_HTTP_DEFAULT			((http_t*)0)
+#define CUPS_WHICHJOBS_ALL			(-1)
+#define CUPS_WHICHJOBS_ACTIVE		(0)
+#define CUPS_WHICHJOBS_COMPLETED	(1)
+
+typedef enum {
+	IPP_JOB_PENDING = 3,
+	IPP_JOB_HELD,
+	IPP_JOB_PROCESSING,
+	IPP_JOB_STOPPED,
+	IPP_JOB_CANCELED,
+	IPP_JOB_ABORTED,
+	IPP_JOB_COMPLETED,
+} ipp_jstate_t;
+
+typedef struct {
+	int				id;
+	char*			dest;
+	char*			title;
+	char*			user;
+	char*			format;
+	ipp_jstate_t	state;
+	int				size;
+	int				priority;
+	time_t			completed_time;
+	time_t			creation_time;
+	time_t			processing_time;
+} cups_job_t;
+
+typedef enum {
+	HTTP_ERROR = -1,
+	HTTP_CONTINUE = 100,
+} http_status_t;
+
+typedef enum {
+	IPP_OK = 0,
+	IPP_INTERNAL_ERROR = 0x0500,
+} ipp_status_t;
+
+#define CUPS_FORMAT_RAW				"application/vnd.cups-raw"
+
+int     cupsParseOptions(const char*, int, cups_option_t**);
+void    cupsFreeOptions(int, cups_option_t*);
+ssize_t cupsBackChannelRead(char*, size_t, double);
+int     cupsGetJobs2(http_t*, cups_job_t**, const char*, int, int);
+void    cupsFreeJobs(int, cups_job_t*);
+int           cupsCreateJob(http_t*, const char*, const char*, int, cups_option_t*);
+http_status_t cupsStartDocument(http_t*, const char*, int, const char*, const char*, int);
+http_status_t cupsWriteRequestData(http_t*, const char*, size_t);
+ipp_status_t  cupsFinishDocument(http_t*, const char*);
+
+#endif
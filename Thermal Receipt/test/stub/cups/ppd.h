@@ -0,0 +1,33 @@
+/*
+ * Minimal libcups PPD declarations for the filter tests.
+ */
+#ifndef TMX_STUB_PPD_H
+#define TMX_STUB_PPD_H
+
+#include <cups/cups.h>
+
+typedef struct {
+	char			name[41];
+	char			spec[41];
+	char			text[81];
+	char*			value;
+} ppd_attr_t;
+
+typedef struct {
+	char			marked;
+	char			choice[41];
+	char			text[81];
+	char*			code;
+	void*			option;
+} ppd_choice_t;
+
+typedef struct _ppd_file_s ppd_file_t;
+
+ppd_file_t*   ppdOpenFile(const char*);
+void          ppdClose(ppd_file_t*);
+void          ppdMarkDefaults(ppd_file_t*);
+int           cupsMarkOptions(ppd_file_t*, int, cups_option_t*);
+ppd_attr_t*   ppdFindAttr(ppd_file_t*, const char*, const char*);
+ppd_choice_t* ppdFindMarkedChoice(ppd_file_t*, const char*);
+
+#endif
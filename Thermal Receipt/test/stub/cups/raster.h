@@ -0,0 +1,86 @@
+/*
+ * Minimal libcups raster declarations for the filter tests.
+ * The filter decodes RaS2/RaS3/RaSt streams itself, so the stub reader only passes other formats through as errors.
+ */
+#ifndef TMX_STUB_RASTER_H
+#define TMX_STUB_RASTER_H
+
+#include <cups/cups.h>
+
+#define CUPS_RASTER_SYNC		0x52615333	// RaS3
+#define CUPS_RASTER_REVSYNC		0x33536152
+#define CUPS_RASTER_SYNCv1		0x52615374	// RaSt
+#define CUPS_RASTER_REVSYNCv1	0x74536152
+#define CUPS_RASTER_SYNCv2		0x52615332	// RaS2
+#define CUPS_RASTER_REVSYNCv2	0x32536152
+
+typedef enum {
+	CUPS_RASTER_READ = 0,
+	CUPS_RASTER_WRITE,
+} cups_mode_t;
+
+typedef enum {
+	CUPS_ORDER_CHUNKED = 0,
+	CUPS_ORDER_BANDED,
+	CUPS_ORDER_PLANAR,
+} cups_order_t;
+
+typedef enum {
+	CUPS_CSPACE_W = 0, CUPS_CSPACE_RGB, CUPS_CSPACE_RGBA, CUPS_CSPACE_K, CUPS_CSPACE_CMY, CUPS_CSPACE_YMC,
+	CUPS_CSPACE_CMYK, CUPS_CSPACE_YMCK, CUPS_CSPACE_KCMY, CUPS_CSPACE_KCMYcm, CUPS_CSPACE_GMCK, CUPS_CSPACE_GMCS,
+	CUPS_CSPACE_WHITE, CUPS_CSPACE_GOLD, CUPS_CSPACE_SILVER, CUPS_CSPACE_CIEXYZ, CUPS_CSPACE_CIELab,
+	CUPS_CSPACE_RGBW, CUPS_CSPACE_SW, CUPS_CSPACE_SRGB, CUPS_CSPACE_ADOBERGB,
+} cups_cspace_t;
+
+typedef struct {											// Version 1 page header (as cups_page_header_t of libcups)
+	char			MediaClass[64];
+	char			MediaColor[64];
+	char			MediaType[64];
+	char			OutputType[64];
+	unsigned		AdvanceDistance;
+	int				AdvanceMedia;
+	int				Collate;
+	int				CutMedia;
+	int				Duplex;
+	unsigned		HWResolution[2];
+	unsigned		ImagingBoundingBox[4];
+	int				InsertSheet;
+	int				Jog;
+	int				LeadingEdge;
+	unsigned		Margins[2];
+	int				ManualFeed;
+	unsigned		MediaPosition;
+	unsigned		MediaWeight;
+	int				MirrorPrint;
+	int				NegativePrint;
+	unsigned		NumCopies;
+	int				Orientation;
+	int				OutputFaceUp;
+	unsigned		PageSize[2];
+	int				Separations;
+	int				TraySwitch;
+	int				Tumble;
+	unsigned		cupsWidth;
+	unsigned		cupsHeight;
+	unsigned		cupsMediaType;
+	unsigned		cupsBitsPerColor;
+	unsigned		cupsBitsPerPixel;
+	unsigned		cupsBytesPerLine;
+	cups_order_t	cupsColorOrder;
+	cups_cspace_t	cupsColorSpace;
+	unsigned		cupsCompression;
+	unsigned		cupsRowCount;
+	unsigned		cupsRowFeed;
+	unsigned		cupsRowStep;
+} cups_page_header_t;
+
+typedef struct _cups_raster_s cups_raster_t;
+typedef ssize_t (*cups_raster_iocb_t)(void*, unsigned char*, size_t);
+
+cups_raster_t* cupsRasterOpen(int, cups_mode_t);
+cups_raster_t* cupsRasterOpenIO(cups_raster_iocb_t, void*, cups_mode_t);
+void           cupsRasterClose(cups_raster_t*);
+unsigned       cupsRasterReadHeader(cups_raster_t*, cups_page_header_t*);
+unsigned       cupsRasterReadPixels(cups_raster_t*, unsigned char*, unsigned);
+
+#endif
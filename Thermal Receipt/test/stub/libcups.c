@@ -0,0 +1,308 @@
+/*
+ * Minimal libcups stand-in for the filter tests.
+ *
+ * - PPD : Main keywords ("*Key: value") are attributes, "*DefaultKey: choice" are the marked choices.
+ * - Backchannel : fd 3, as cupsd passes it to filters.
+ * - Job queue : TMX_STUB_PENDING_JOBS other jobs are pending on the printer. (Read from the file TMX_STUB_JOB_FILE
+ *   instead if it exists, so that a test can change the queue after the filter ended. The file may give the number
+ *   of held jobs after the number of pending jobs.)
+ * - Submitted jobs : The data is appended to the file TMX_STUB_SUBMITTED.
+ */
+#include <cups/ppd.h>
+#include <cups/raster.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/select.h>
+
+#define STUB_MAX_ATTRS		(256)
+#define STUB_MAX_CHOICES	(64)
+
+struct _ppd_file_s {
+	int				attrCount;
+	ppd_attr_t		attrs[STUB_MAX_ATTRS];
+	int				choiceCount;
+	char			keywords[STUB_MAX_CHOICES][41];
+	ppd_choice_t	choices[STUB_MAX_CHOICES];
+};
+
+static ppd_choice_t* MarkChoice(ppd_file_t* ppd, const char* keyword, const char* choice)
+{
+	int i;
+	for ( i = 0; i < ppd->choiceCount; i++ ) {
+		if ( 0 == strcmp( ppd->keywords[i], keyword ) ) {
+			break;
+		}
+	}
+	if ( STUB_MAX_CHOICES == i ) {
+		return NULL;
+	}
+	if ( i == ppd->choiceCount ) {
+		snprintf( ppd->keywords[i], sizeof(ppd->keywords[i]), "%.40s", keyword );
+		ppd->choiceCount++;
+	}
+	snprintf( ppd->choices[i].choice, sizeof(ppd->choices[i].choice), "%.40s", choice );
+	ppd->choices[i].marked = 1;
+	
+	return &ppd->choices[i];
+}
+
+ppd_file_t* ppdOpenFile(const char* filename)
+{
+	FILE* fp = fopen( filename, "r" );
+	if ( NULL == fp ) {
+		return NULL;
+	}
+	
+	ppd_file_t* ppd = calloc( 1, sizeof(ppd_file_t) );
+	char line[1024];
+	while ( (NULL != ppd) && (NULL != fgets( line, sizeof(line), fp )) ) {
+		if ( ('*' != line[0]) || ('%' == line[1]) ) {
+			continue;
+		}
+		char* colon = strchr( line, ':' );
+		if ( NULL == colon ) {
+			continue;
+		}
+		*colon = '\0';
+		char* keyword = line + 1;
+		char* value   = colon + 1;
+		if ( NULL != strchr( keyword, ' ' ) ) { // Option choices and UI keywords
+			continue;
+		}
+		while ( ' ' == *value ) {
+			value++;
+		}
+		if ( '"' == *value ) {
+			value++;
+			value[strcspn( value, "\"" )] = '\0';
+		}
+		else {
+			value[strcspn( value, "\r\n" )] = '\0';
+		}
+		
+		if ( 0 == strncmp( keyword, "Default", 7 ) ) {
+			MarkChoice( ppd, keyword + 7, value );
+		}
+		else if ( STUB_MAX_ATTRS > ppd->attrCount ) {
+			ppd_attr_t* attr = &ppd->attrs[ppd->attrCount++];
+			snprintf( attr->name, sizeof(attr->name), "%.40s", keyword );
+			attr->value = strdup( value );
+		}
+	}
+	fclose( fp );
+	
+	return ppd;
+}
+
+void ppdClose(ppd_file_t* ppd)
+{
+	if ( NULL != ppd ) {
+		int i;
+		for ( i = 0; i < ppd->attrCount; i++ ) {
+			free( ppd->attrs[i].value );
+		}
+		free( ppd );
+	}
+}
+
+void ppdMarkDefaults(ppd_file_t* ppd)
+{
+	(void)ppd; // Defaults are marked when the file is read.
+}
+
+int cupsMarkOptions(ppd_file_t* ppd, int num_options, cups_option_t* options)
+{
+	int i;
+	for ( i = 0; i < num_options; i++ ) {
+		MarkChoice( ppd, options[i].name, options[i].value );
+	}
+	
+	return 0;
+}
+
+ppd_attr_t* ppdFindAttr(ppd_file_t* ppd, const char* name, const char* spec)
+{
+	(void)spec;
+	
+	int i;
+	for ( i = 0; i < ppd->attrCount; i++ ) {
+		if ( 0 == strcmp( ppd->attrs[i].name, name ) ) {
+			return &ppd->attrs[i];
+		}
+	}
+	
+	return NULL;
+}
+
+ppd_choice_t* ppdFindMarkedChoice(ppd_file_t* ppd, const char* keyword)
+{
+	int i;
+	for ( i = 0; i < ppd->choiceCount; i++ ) {
+		if ( 0 == strcmp( ppd->keywords[i], keyword ) ) {
+			return &ppd->choices[i];
+		}
+	}
+	
+	return NULL;
+}
+
+int cupsParseOptions(const char* arg, int num_options, cups_option_t** options)
+{
+	char* copy  = strdup( (NULL != arg) ? arg : "" );
+	char* token = NULL;
+	
+	for ( token = strtok( copy, " " ); NULL != token; token = strtok( NULL, " " ) ) {
+		char* equal = strchr( token, '=' );
+		if ( NULL == equal ) {
+			continue;
+		}
+		*equal = '\0';
+		
+		cups_option_t* resized = realloc( *options, (num_options + 1) * sizeof(cups_option_t) );
+		if ( NULL == resized ) {
+			break;
+		}
+		*options = resized;
+		(*options)[num_options].name  = strdup( token );
+		(*options)[num_options].value = strdup( equal + 1 );
+		num_options++;
+	}
+	free( copy );
+	
+	return num_options;
+}
+
+void cupsFreeOptions(int num_options, cups_option_t* options)
+{
+	int i;
+	for ( i = 0; i < num_options; i++ ) {
+		free( options[i].name );
+		free( options[i].value );
+	}
+	free( options );
+}
+
+ssize_t cupsBackChannelRead(char* buffer, size_t bytes, double timeout)
+{
+	fd_set         input;
+	struct timeval tval;
+	
+	FD_ZERO( &input );
+	FD_SET( 3, &input );
+	tval.tv_sec  = (time_t)timeout;
+	tval.tv_usec = (suseconds_t)((timeout - (double)tval.tv_sec) * 1000000.0);
+	
+	int result = select( 4, &input, NULL, NULL, (0.0 > timeout) ? NULL : &tval );
+	if ( 0 > result ) {
+		return -1;
+	}
+	if ( 0 == result ) {
+		errno = ETIMEDOUT;
+		return -1;
+	}
+	
+	return read( 3, buffer, bytes );
+}
+
+int cupsGetJobs2(http_t* http, cups_job_t** jobs, const char* name, int myjobs, int whichjobs)
+{
+	(void)http; (void)name; (void)myjobs; (void)whichjobs;
+	
+	const char* pending = getenv( "TMX_STUB_PENDING_JOBS" );
+	int count = (NULL != pending) ? atoi( pending ) : 0;
+	int held = 0;
+	
+	const char* path = getenv( "TMX_STUB_JOB_FILE" );
+	FILE* fp = (NULL != path) ? fopen( path, "r" ) : NULL;
+	if ( NULL != fp ) {
+		if ( 1 > fscanf( fp, "%d %d", &count, &held ) ) {
+			count = 0;
+		}
+		fclose( fp );
+	}
+	
+	*jobs = calloc( count + held + 1, sizeof(cups_job_t) );
+	if ( NULL == *jobs ) {
+		return -1;
+	}
+	
+	int i;
+	for ( i = 0; i < count + held; i++ ) {
+		(*jobs)[i].id    = 1000 + i;
+		(*jobs)[i].state = (i < count) ? IPP_JOB_PENDING : IPP_JOB_HELD;
+	}
+	
+	return count + held;
+}
+
+void cupsFreeJobs(int num_jobs, cups_job_t* jobs)
+{
+	(void)num_jobs;
+	free( jobs );
+}
+
+static FILE* g_StubDocument;
+
+int cupsCreateJob(http_t* http, const char* name, const char* title, int num_options, cups_option_t* options)
+{
+	(void)http; (void)name; (void)title; (void)num_options; (void)options;
+	
+	return (NULL != getenv( "TMX_STUB_SUBMITTED" )) ? 2000 : 0;
+}
+
+http_status_t cupsStartDocument(http_t* http, const char* name, int job_id, const char* docname, const char* format, int last_document)
+{
+	(void)http; (void)name; (void)job_id; (void)docname; (void)format; (void)last_document;
+	
+	g_StubDocument = fopen( getenv( "TMX_STUB_SUBMITTED" ), "ab" );
+	return (NULL != g_StubDocument) ? HTTP_CONTINUE : HTTP_ERROR;
+}
+
+http_status_t cupsWriteRequestData(http_t* http, const char* buffer, size_t length)
+{
+	(void)http;
+	
+	return (length == fwrite( buffer, 1, length, g_StubDocument )) ? HTTP_CONTINUE : HTTP_ERROR;
+}
+
+ipp_status_t cupsFinishDocument(http_t* http, const char* name)
+{
+	(void)http; (void)name;
+	
+	return (0 == fclose( g_StubDocument )) ? IPP_OK : IPP_INTERNAL_ERROR;
+}
+
+cups_raster_t* cupsRasterOpenIO(cups_raster_iocb_t iocb, void* ctx, cups_mode_t mode)
+{
+	(void)iocb; (void)ctx; (void)mode;
+	
+	return NULL; // Formats the filter does not decode are not supported by the stub.
+}
+
+cups_raster_t* cupsRasterOpen(int fd, cups_mode_t mode)
+{
+	(void)fd; (void)mode;
+	
+	return NULL;
+}
+
+void cupsRasterClose(cups_raster_t* raster)
+{
+	(void)raster;
+}
+
+unsigned cupsRasterReadHeader(cups_raster_t* raster, cups_page_header_t* header)
+{
+	(void)raster; (void)header;
+	
+	return 0;
+}
+
+unsigned cupsRasterReadPixels(cups_raster_t* raster, unsigned char* pixels, unsigned length)
+{
+	(void)raster; (void)pixels; (void)length;
+	
+	return 0;
+}
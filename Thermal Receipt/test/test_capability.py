@@ -0,0 +1,126 @@
+"""Capability probe (GS I / GS ( L) and its cache file."""
+
+import os
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 576
+
+
+def receipt(height=300):
+    return tmx.raster([(WIDTH, tmx.text(WIDTH, height))])
+
+
+def age_capability(seconds):
+    """Move the time of a failed probe back."""
+    capability = tmx.data_file('Capability')
+    capability['Time'] = str(int(capability['Time']) - seconds)
+    path = os.path.join(tmx.DATA_DIR, tmx.PRINTER + '_Capability.dat')
+    with open(path, 'w') as fp:
+        fp.write(''.join('%s=%s\n' % item for item in capability.items()))
+
+
+class CapabilityTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+
+    def test_complete_probe_is_cached(self):
+        result = FakePrinter().run(receipt())
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(tmx.data_file('Capability'), {
+            'Probed': '1', 'ModelId': '32', 'ModelName': 'TM-FAKE', 'BufferCapacity': '65536', 'GraphicsCommand': '0',
+            'Time': '0'})
+        self.assertTrue(result.find(tmx.GS_8L))
+        self.assertEqual(result.unread, b'')
+
+        again = FakePrinter().run(receipt())
+        self.assertEqual(again.returncode, 0, again.log)
+        self.assertEqual(again.find(tmx.GS_I), [])
+        self.assertEqual(tmx.render(again.output), tmx.render(result.output))
+
+    def test_busy_printer_is_probed_again_later(self):
+        busy = FakePrinter(busy=2.5).run(receipt())
+        self.assertEqual(busy.returncode, 0, busy.log)
+        self.assertIn('Error Code=5002', busy.log)
+        self.assertEqual(tmx.data_file('Capability')['Probed'], '0')
+
+        soon = FakePrinter().run(receipt())
+        self.assertEqual(soon.returncode, 0, soon.log)
+        self.assertEqual(soon.find(tmx.GS_I), [])
+
+        age_capability(601)
+        ready = FakePrinter().run(receipt())
+        self.assertEqual(ready.returncode, 0, ready.log)
+        self.assertTrue(ready.find(tmx.GS_I))
+        self.assertEqual(tmx.data_file('Capability')['Probed'], '1')
+
+    def test_late_answers_are_drained(self):
+        late = FakePrinter(stall={tmx.GS_I + b'\x43': 2.2}).run(receipt())
+        self.assertEqual(late.returncode, 0, late.log)
+        self.assertIn('Error Code=5004', late.log)
+        self.assertEqual(tmx.data_file('Capability')['Probed'], '0')
+        self.assertEqual(late.unread, b'')
+
+    def test_unsupported_graphics_command_is_cached(self):
+        result = FakePrinter(gs_l=False).run(receipt())
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(tmx.data_file('Capability')['GraphicsCommand'], '1')
+        self.assertEqual(result.find(tmx.GS_8L), [])
+        self.assertTrue(result.find(tmx.GS_V0))
+        self.assertLess(result.elapsed, 2.0)
+
+        raster = FakePrinter().run(receipt())
+        self.assertEqual(tmx.render(raster.output), tmx.render(result.output))
+
+    def test_no_backchannel(self):
+        result = FakePrinter(backchannel=False).run(receipt())
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(tmx.data_file('Capability')['Probed'], '0')
+        self.assertTrue(result.find(tmx.GS_8L))
+        self.assertLess(result.elapsed, 2.0)
+
+    def test_mute_printer_is_probed_once(self):
+        result = FakePrinter(mute=True).run(receipt())
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertTrue(result.find(tmx.GS_I))
+        self.assertEqual(tmx.data_file('Capability')['Probed'], '0')
+
+        again = FakePrinter(mute=True).run(receipt())
+        self.assertEqual(again.returncode, 0, again.log)
+        self.assertEqual(again.find(tmx.GS_I), [])
+        self.assertLess(again.elapsed, 1.0)
+
+    def test_status_is_not_taken_as_model_id(self):
+        class StatusFirstPrinter(FakePrinter):
+            def answer(self, command):
+                data, realtime = FakePrinter.answer(self, command)
+                if command == tmx.GS_I + b'\x01':
+                    data = b'\x16' + data          # A status byte arrives before the model ID.
+                return data, realtime
+
+        result = StatusFirstPrinter(model_id=0x30).run(receipt())      # Bit 4 is not a status flag.
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(tmx.data_file('Capability')['ModelId'], str(0x30))
+        self.assertTrue(result.find(tmx.GS_8L))
+
+    def test_band_height(self):
+        result = FakePrinter(capacity=1000000).run(receipt(1000))
+        self.assertEqual(result.returncode, 0, result.log)
+        heights = [band[15] | band[16] << 8 for band in result.find(tmx.GS_8L)]
+        self.assertEqual(max(heights), 256)
+        self.assertEqual(sum(heights), 1000 - 8)    # The first glyph row starts at line 8.
+
+    def test_band_height_follows_capacity(self):
+        FakePrinter(capacity=(WIDTH // 8) * 100).run(receipt())
+        result = FakePrinter().run(receipt(1000))
+        self.assertEqual(result.returncode, 0, result.log)
+        heights = [band[15] | band[16] << 8 for band in result.find(tmx.GS_8L)]
+        self.assertEqual(max(heights), 100)
+        self.assertEqual(sum(heights), 1000 - 8)
+        self.assertEqual(tmx.render(result.output), tmx.render(FakePrinter(capacity=1000000).run(receipt(1000)).output))
+
+
+if __name__ == '__main__':
+    unittest.main()
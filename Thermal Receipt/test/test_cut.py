@@ -0,0 +1,114 @@
+"""Reserved cut mode (TmxCutMode=Reserved) and its fallbacks to an immediate cut.
+
+The filter is built with EPTMD_RESERVED_CUT_TIMEOUT=1, so the watcher of a reserved cut checks after 1 s.
+"""
+
+import os
+import tempfile
+import time
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 576
+OPTIONS = 'TmxPaperCut=CutPerJob TmxCutMode=Reserved'
+CUT = b'\x1dV\x42\x00'                  # GS V <Function B> : feed to the cutter and cut
+RESERVED_CUT = b'\x1dV\x62\x00'         # GS V <Function C> : cut when the paper reaches the cutter
+ESC_AT = b'\x1b@'
+CUT_JOB = ESC_AT + b'\x1bJ\x00' + CUT    # ESC @ cancels the reservation before the cut.
+
+
+def receipt():
+    return tmx.raster([(WIDTH, tmx.text(WIDTH, 100))])
+
+
+class CutTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+        self.temp = tempfile.TemporaryDirectory()
+        self.job_file = os.path.join(self.temp.name, 'jobs')
+        self.submitted = os.path.join(self.temp.name, 'submitted')
+        self.env = {'TMX_STUB_JOB_FILE': self.job_file, 'TMX_STUB_SUBMITTED': self.submitted}
+
+    def tearDown(self):
+        self.temp.cleanup()
+
+    def queue(self, pending, held=0):
+        with open(self.job_file, 'w') as fp:
+            fp.write('%d %d\n' % (pending, held))
+
+    def run_job(self):
+        result = FakePrinter().run(receipt(), OPTIONS, env=self.env)
+        self.assertEqual(result.returncode, 0, result.log)
+        return result
+
+    def submitted_jobs(self):
+        time.sleep(2.0)                 # Watcher timeout + margin
+        if not os.path.exists(self.submitted):
+            return b''
+        with open(self.submitted, 'rb') as fp:
+            return fp.read()
+
+    def test_standalone_receipt_is_cut_at_once(self):
+        self.queue(0)
+        result = self.run_job()
+        self.assertEqual(result.find(CUT), [CUT])
+        self.assertEqual(result.find(RESERVED_CUT), [])
+        self.assertLess(result.elapsed, 2.0)
+
+    def test_held_job_does_not_delay_the_cut(self):
+        self.queue(0, held=1)           # A held job may not be released for hours.
+        result = self.run_job()
+        self.assertEqual(result.find(CUT), [CUT])
+        self.assertEqual(result.find(RESERVED_CUT), [])
+        self.assertLess(result.elapsed, 2.0)
+
+    def test_cut_is_reserved_for_pending_job(self):
+        self.queue(1)
+        result = self.run_job()
+        self.assertEqual(result.find(RESERVED_CUT), [RESERVED_CUT])
+        self.assertEqual(result.find(CUT), [])
+        self.assertEqual(tmx.data_file('State')['CutReserved'], '1')
+        self.assertEqual(self.submitted_jobs(), b'')    # The pending job feeds the paper.
+
+    def test_unsaved_reservation_cuts_at_once(self):
+        self.queue(1)
+        state = os.path.join(tmx.DATA_DIR, tmx.PRINTER + '_State.dat')
+        os.makedirs(os.path.join(state, 'unwritable'))
+        try:
+            result = self.run_job()
+        finally:
+            os.rmdir(os.path.join(state, 'unwritable'))
+            os.rmdir(state)
+        self.assertEqual(result.find(CUT), [CUT])
+        self.assertEqual(result.find(RESERVED_CUT), [])
+
+    def test_cut_job_when_the_next_job_does_not_start(self):
+        self.queue(1)
+        self.run_job()
+        self.queue(0)                   # The next job is canceled.
+        self.assertEqual(self.submitted_jobs(), CUT_JOB)
+        self.assertIsNone(tmx.data_file('State'))
+
+    def test_job_after_the_cut_job(self):
+        """The printer was initialized by the cut job, so the next job neither cuts again nor reuses the settings."""
+        self.queue(1)
+        self.run_job()
+        self.queue(0)
+        self.assertEqual(self.submitted_jobs(), CUT_JOB)
+        result = self.run_job()
+        self.assertIn('Printer initialization = full', result.log)
+        self.assertEqual(result.find(ESC_AT), [ESC_AT])
+        self.assertEqual(result.find(CUT), [CUT])       # Only the cut of the job itself
+
+    def test_no_cut_job_when_the_next_job_starts(self):
+        self.queue(1)
+        self.run_job()
+        os.remove(os.path.join(tmx.DATA_DIR, tmx.PRINTER + '_State.dat'))    # Removed by the next job.
+        self.queue(0)
+        self.assertEqual(self.submitted_jobs(), b'')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,41 @@
+"""Draft resolution (101 x 101 dpi) printed with the printer magnification.
+
+Graphics, margins and feeds of a magnified page must all be printed at the same 2 dots per raster line.
+"""
+
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 288
+
+
+def margins(rows):
+    """(top margin, ink height, bottom margin) of the rendered rows before the first cut."""
+    rows = rows[:rows.index('CUT')] if 'CUT' in rows else rows
+    ink = [y for y, row in enumerate(rows) if row]
+    return ink[0], ink[-1] + 1 - ink[0], len(rows) - ink[-1] - 1
+
+
+class DraftTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+
+    def test_feeds_follow_graphics(self):
+        rows = tmx.solid(WIDTH, 1000, 0, 300, WIDTH, 400)
+        result = FakePrinter().run(tmx.raster([(WIDTH, rows)], resolution=101))
+        self.assertEqual(result.returncode, 0, result.log)
+
+        top, height, bottom = margins(tmx.render(result.output))
+        self.assertEqual(height, 2 * 100)
+        self.assertEqual(top, 2 * 300)
+
+        # The bottom margin matches the same page at full resolution.
+        full = tmx.solid(2 * WIDTH, 2000, 0, 600, 2 * WIDTH, 800)
+        reference = FakePrinter().run(tmx.raster([(2 * WIDTH, full)]))
+        self.assertEqual(bottom, margins(tmx.render(reference.output))[2])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,64 @@
+"""Cash drawer kick timing (TmxDrawerKick).
+
+The printer is still busy with a previous receipt for 2 s when the job starts. A queued ESC p is executed
+after it, the real-time DLE DC4 <Function 1> as soon as it is received.
+"""
+
+import os
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 576
+BUSY = 2.0
+ESC_AT = b'\x1b@'
+ESC_P_DRAWER1 = b'\x1bp\x00'
+DLE_DC4_DRAWER1 = tmx.DLE_DC4 + b'\x01\x00'
+
+
+def receipt():
+    return tmx.raster([(WIDTH, tmx.text(WIDTH, 300))])
+
+
+def executed(printer, prefix):
+    return [seconds for seconds, command in printer.executed if tmx.is_command(command, prefix)]
+
+
+class DrawerKickTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+
+    def test_real_time_kick_goes_first(self):
+        result = FakePrinter().run(receipt(), 'TmxBuzzerAndDrawer=OpenDrawer1 TmxDrawerKick=RealTime')
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(result.find(ESC_P_DRAWER1), [])
+        kick = result.commands.index(DLE_DC4_DRAWER1 + b'\x01')
+        for prefix in (b'\x1b=', tmx.GS_I, ESC_AT, tmx.GS_8L):
+            first = min(i for i, command in enumerate(result.commands) if tmx.is_command(command, prefix))
+            self.assertLess(kick, first)
+
+    def test_real_time_kick_is_not_queued_behind_the_busy_printer(self):
+        FakePrinter().run(receipt())                    # Probe the printer beforehand.
+
+        queued = FakePrinter(busy=BUSY)
+        result = queued.run(receipt(), 'TmxBuzzerAndDrawer=OpenDrawer1 TmxDrawerKick=Queued')
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertGreaterEqual(min(executed(queued, ESC_P_DRAWER1)), BUSY)
+
+        realtime = FakePrinter(busy=BUSY)
+        result = realtime.run(receipt(), 'TmxBuzzerAndDrawer=OpenDrawer1 TmxDrawerKick=RealTime')
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertLess(min(executed(realtime, DLE_DC4_DRAWER1)), 0.5)
+        self.assertEqual(executed(realtime, ESC_P_DRAWER1), [])
+
+    def test_resumed_job_does_not_kick_again(self):
+        with open(os.path.join(tmx.DATA_DIR, tmx.PRINTER + '_Checkpoint.dat'), 'w') as fp:
+            fp.write('Job=7\nBandLines=256\nCheckpoint=1\n')
+        result = FakePrinter().run(receipt(), 'TmxBuzzerAndDrawer=OpenDrawer1 TmxDrawerKick=RealTime TmxResume=Band')
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(result.find(DLE_DC4_DRAWER1), [])
+
+
+if __name__ == '__main__':
+    unittest.main()
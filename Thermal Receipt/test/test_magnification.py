@@ -0,0 +1,90 @@
+"""Bands of doubled pixels sent at half size with the GS 8 L magnification, and feeds of magnified pages.
+
+The rendered output must be the source page dot for dot. Widths and band heights are odd on purpose.
+"""
+
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 575                     # The last dot has no pair.
+HEIGHT = 256 + 101              # The last band has an odd number of lines.
+
+
+def doubled(h, v, seed=1):
+    """A page whose pixels are doubled h times horizontally and v times vertically."""
+    half = tmx.text((WIDTH - 1) // h, (HEIGHT + v - 1) // v, seed=seed)
+    rows = []
+    for source in half:
+        row = bytearray((WIDTH + 7) // 8)
+        for x in range((WIDTH - 1) // h * h):
+            if source[x // h // 8] & (0x80 >> (x // h % 8)):
+                row[x // 8] |= 0x80 >> (x % 8)
+        rows.extend([bytes(row)] * v)
+    return rows[:HEIGHT]
+
+
+def dots(rows):
+    return [tuple(x for x in range(WIDTH) if row[x // 8] & (0x80 >> (x % 8))) for row in rows]
+
+
+def ink(rows):
+    """Rows from the first to the last row with dots, before the first cut."""
+    rows = rows[:rows.index('CUT')] if 'CUT' in rows else rows
+    marked = [y for y, row in enumerate(rows) if row]
+    return rows[marked[0]:marked[-1] + 1]
+
+
+def scales(result):
+    return {(band[10], band[11]) for band in result.find(tmx.GS_8L) if band[8] == 112}
+
+
+class MagnificationTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+
+    def check(self, h, v):
+        rows = doubled(h, v)
+        result = FakePrinter().run(tmx.raster([(WIDTH, rows)]))
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertIn((h, v), scales(result))
+        self.assertEqual(ink(tmx.render(result.output)), ink(dots(rows)))
+        return result
+
+    def test_horizontal(self):
+        self.check(2, 1)
+
+    def test_vertical(self):
+        result = self.check(1, 2)
+        self.assertIn((1, 1), scales(result))      # The odd last band is sent at full size.
+
+    def test_both(self):
+        result = self.check(2, 2)
+        sent = sum(len(band) - 17 for band in result.find(tmx.GS_8L))
+        self.assertLess(sent, ((WIDTH + 7) // 8) * HEIGHT * 0.4)
+
+    def test_not_doubled(self):
+        rows = tmx.text(WIDTH, HEIGHT)
+        result = FakePrinter().run(tmx.raster([(WIDTH, rows)]))
+        self.assertEqual(scales(result), {(1, 1)})
+        self.assertEqual(ink(tmx.render(result.output)), ink(dots(rows)))
+
+    def test_magnified_page_feeds(self):
+        """The blank lines around the graphics of a 101 dpi page are fed at 2 dots per line like the graphics."""
+        rows = tmx.solid(288, 601, 0, 301, 288, 312)
+        result = FakePrinter().run(tmx.raster([(288, rows)], resolution=101))
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(scales(result), {(2, 2)})
+
+        full = tmx.solid(576, 1202, 0, 602, 576, 624)
+        reference = FakePrinter().run(tmx.raster([(576, full)]))
+        for printed in (tmx.render(result.output), tmx.render(reference.output)):
+            printed = printed[:printed.index('CUT')] if 'CUT' in printed else printed
+            marked = [y for y, row in enumerate(printed) if row]
+            self.assertEqual((marked[0], len(marked)), (602, 22))
+        self.assertEqual(len(tmx.render(result.output)), len(tmx.render(reference.output)))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,55 @@
+"""Progress reports and the stall warning of WriteData.
+
+The filter is built with EPTMD_STALL_TIMEOUT=1, so a printer that does not read for 1 s raises the warning.
+"""
+
+import re
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 576
+
+
+def receipt(pages=1, height=3000):
+    return tmx.raster([(WIDTH, tmx.text(WIDTH, height, seed=page + 1)) for page in range(pages)])
+
+
+def progress(result):
+    return [int(value) for value in re.findall(r'^ATTR: job-media-progress=(\d+)$', result.log, re.M)]
+
+
+def states(result):
+    return re.findall(r'^STATE: (.*)$', result.log, re.M)
+
+
+class ProgressTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+
+    def test_reports_are_rate_limited(self):
+        result = FakePrinter().run(receipt(pages=2))
+        self.assertEqual(result.returncode, 0, result.log)
+        bands = len([band for band in result.find(tmx.GS_8L) if band[8] == 112])
+        self.assertGreater(bands, 20)
+        self.assertEqual(progress(result), [100, 100])      # Only the forced report at the end of each page
+        self.assertEqual(len(re.findall(r'^INFO: Page \d+: ', result.log, re.M)), 2)
+        self.assertEqual(states(result), [])
+
+    def test_stall_warning_is_cleared(self):
+        result = FakePrinter(pause=(20000, 2.5)).run(receipt())     # The pipe fills up while the printer does not read.
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertRegex(result.log, r'WARNING: Printer has not accepted data for 1 seconds \(\d+ bytes sent\)')
+        self.assertRegex(result.log, r'INFO: Printer accepted data after [12] seconds')
+        self.assertEqual(states(result), ['+other-warning', '-other-warning'])
+
+        # The report after the stall shows the partial page.
+        reports = progress(result)
+        self.assertEqual(reports[-1], 100)
+        self.assertTrue(any(0 < percent < 100 for percent in reports[:-1]), reports)
+        self.assertEqual(reports, sorted(reports))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,65 @@
+"""Raster streams decoded by the filter (../../Common/filter/TmRasterStream.c)."""
+
+import struct
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 576
+
+
+def encode_line(row):
+    """RaS2 records of one line. (Literal runs, single bytes as a repeat of 1)"""
+    out = bytearray(b'\x00')                # Line repeat : 1 line
+    for i in range(0, len(row), 128):
+        chunk = row[i:i + 128]
+        if len(chunk) == 1:
+            out += b'\x00' + chunk
+        else:
+            out += bytes([257 - len(chunk)]) + chunk
+    return bytes(out)
+
+
+def ras2(rows, big_endian=False, line=encode_line):
+    header = bytearray(tmx.page_header(WIDTH, len(rows)))
+    sync = b'RaS2'
+    if big_endian:                          # Only the 81 numeric words follow the byte order.
+        words = struct.unpack_from('<81I', header, 256)
+        struct.pack_into('>81I', header, 256, *words)
+    else:
+        sync = sync[::-1]
+    return sync + bytes(header) + b''.join(line(row) for row in rows)
+
+
+class RasterStreamTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+
+    def printed(self, data):
+        result = FakePrinter().run(data)
+        self.assertEqual(result.returncode, 0, result.log)
+        return tmx.render(result.output)
+
+    def test_compressed_streams_in_both_byte_orders(self):
+        rows = tmx.text(WIDTH, 200)
+        expected = self.printed(tmx.raster([(WIDTH, rows)]))
+        self.assertEqual(self.printed(ras2(rows)), expected)
+        self.assertEqual(self.printed(ras2(rows, big_endian=True)), expected)
+
+    def test_strings_are_not_swapped(self):
+        rows = tmx.text(WIDTH, 50)
+        data = bytearray(ras2(rows, big_endian=True))
+        data[4 + 256 + 81 * 4:4 + 256 + 81 * 4 + 4] = b'TM\x00\x00'      # cupsString[0]
+        self.assertEqual(self.printed(bytes(data)), self.printed(tmx.raster([(WIDTH, rows)])))
+
+    def test_run_past_the_line_fails_the_page(self):
+        def overrun(row):
+            return b'\x00' + bytes([257 - 128]) + row + bytes(128 - len(row))
+        result = FakePrinter().run(ras2(tmx.text(WIDTH, 50), line=overrun))
+        self.assertNotEqual(result.returncode, 0)
+        self.assertIn('Error Code=3303', result.log)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,71 @@
+"""Real-time command handling in graphics (TmxRealTimeCommand).
+
+GS ( D only disables DLE DC4 <Function 1> and <Function 2>, so the other DLE DC4 functions, DLE EOT, DLE ENQ and ESC =
+in image data are always altered.
+"""
+
+import re
+import tempfile
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 576
+GS_D = b'\x1d(D'
+SEQUENCES = {'DLE EOT': b'\x10\x04', 'DLE ENQ': b'\x10\x05', 'DLE DC4 fn 1': b'\x10\x14\x01',
+             'DLE DC4 fn 7': b'\x10\x14\x07', 'ESC =': b'\x1b\x3d'}
+
+
+def image():
+    rows = tmx.text(WIDTH, 300)
+    row = bytearray(rows[100])
+    row[10:18] = b'\x10\x04\x01\x10\x05\x00\x1b\x3d'
+    row[30:33] = b'\x10\x14\x01'
+    row[40:44] = b'\x10\x14\x07\x01'     # Transmit status in real time
+    rows[100] = bytes(row)
+    return tmx.raster([(WIDTH, rows)])
+
+
+def image_data(result):
+    return b''.join(command[17:] for command in result.find(tmx.GS_8L) if command[8] == 112)
+
+
+class RealTimeCommandTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+
+    def sequences(self, result):
+        self.assertEqual(result.returncode, 0, result.log)
+        data = image_data(result)
+        return {name for name, sequence in SEQUENCES.items() if sequence in data}
+
+    def test_patch(self):
+        result = FakePrinter().run(image(), 'TmxRealTimeCommand=Patch')
+        self.assertEqual(self.sequences(result), set())
+        self.assertEqual(result.find(GS_D), [])
+
+    def test_disable_keeps_only_dle_dc4_fn_1_and_2(self):
+        result = FakePrinter().run(image(), 'TmxRealTimeCommand=Disable')
+        self.assertEqual(self.sequences(result), {'DLE DC4 fn 1'})
+        self.assertEqual([command[7] for command in result.find(GS_D)], [0, 1])
+
+    def test_disable_needs_the_model(self):
+        with open(tmx.PPD_203) as fp:
+            ppd = fp.read()
+        with tempfile.NamedTemporaryFile('w', suffix='.ppd') as unknown:
+            unknown.write(re.sub(r'\*TmxRealTimeSwitch: "\w+"\n', '', ppd))
+            unknown.flush()
+            result = FakePrinter().run(image(), 'TmxRealTimeCommand=Disable', unknown.name)
+        self.assertEqual(self.sequences(result), set())
+        self.assertEqual(result.find(GS_D), [])
+
+    def test_disable_refuses_real_time_drawer_kick(self):
+        result = FakePrinter().run(image(), 'TmxRealTimeCommand=Disable TmxDrawerKick=RealTime')
+        self.assertNotEqual(result.returncode, 0)
+        self.assertIn('Error Code=4703', result.log)
+        self.assertEqual(result.find(tmx.GS_8L), [])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,95 @@
+"""Resuming a job interrupted by an output failure (TmxResume=Band).
+
+The connection is dropped in the second page, and the job is run again like CUPS retries it.
+A page of 600 lines is printed in 3 bands, so the checkpoints of a page are its 3 bands and the page end.
+"""
+
+import os
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 576
+OPTIONS = 'TmxResume=Band'
+CHECKPOINTS_PER_PAGE = 4
+
+
+def receipt():
+    return tmx.raster([(WIDTH, tmx.text(WIDTH, 600, seed=1)), (WIDTH, tmx.text(WIDTH, 600, seed=2))])
+
+
+def checkpoint_path():
+    return os.path.join(tmx.DATA_DIR, tmx.PRINTER + '_Checkpoint.dat')
+
+
+def write_checkpoint(text):
+    with open(checkpoint_path(), 'w') as fp:
+        fp.write(text)
+
+
+def bands(result):
+    return [command for command in result.find(tmx.GS_8L) if command[8] == 112]
+
+
+class ResumeTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+        self.complete = FakePrinter().run(receipt(), OPTIONS)
+        self.assertEqual(self.complete.returncode, 0, self.complete.log)
+        self.assertIsNone(tmx.data_file('Checkpoint'))
+
+    def interrupt(self):
+        """Drop the connection in the first band of the second page. The printer takes 0.2 s per band."""
+        offsets = [offset for offset, command in tmx.commands(self.complete.output)
+                   if tmx.is_command(command, tmx.GS_8L) and command[8] == 112]
+        printer = FakePrinter(stall={tmx.GS_8L: 0.2}, drop_after=offsets[3] + 100)
+        result = printer.run(receipt(), OPTIONS)
+        self.assertNotEqual(result.returncode, 0)
+
+    def test_page_end_is_recorded(self):
+        self.interrupt()
+        self.assertEqual(tmx.data_file('Checkpoint'),
+                         {'Job': '7', 'BandLines': '256', 'Checkpoint': str(CHECKPOINTS_PER_PAGE)})
+
+    def test_printed_page_is_skipped(self):
+        self.interrupt()
+        os.unlink(os.path.join(tmx.DATA_DIR, tmx.PRINTER + '_Capability.dat'))
+        result = FakePrinter().run(receipt(), OPTIONS)
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(bands(result), bands(self.complete)[3:])
+        self.assertIsNone(tmx.data_file('Checkpoint'))
+
+        # The buffer is cleared before anything else is sent. (The printer may be inside the dropped GS 8 L.)
+        self.assertEqual(result.commands[0:1], result.find(tmx.DLE_DC4_CLEAR))
+        self.assertTrue(result.find(tmx.GS_I))
+
+    def test_clear_is_not_waited_for_without_backchannel(self):
+        write_checkpoint('Job=7\nBandLines=256\nCheckpoint=%d\n' % CHECKPOINTS_PER_PAGE)
+        os.unlink(os.path.join(tmx.DATA_DIR, tmx.PRINTER + '_Capability.dat'))
+        result = FakePrinter(mute=True).run(receipt(), OPTIONS)
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(len(result.find(tmx.DLE_DC4_CLEAR)), 1)
+        self.assertEqual(result.find(tmx.GS_I), [])     # A printer that does not answer the clear is not probed.
+        self.assertLess(result.elapsed, 3.0)            # One probe timeout
+
+    def test_next_page_is_not_held_back(self):
+        """The page end waits 1 s at most for the responses, not until a slow printer has printed the page."""
+        printer = FakePrinter(stall={tmx.GS_8L: 1.0})
+        result = printer.run(receipt(), OPTIONS)
+        self.assertEqual(result.returncode, 0, result.log)
+        received = [seconds for seconds, command in printer.received
+                    if tmx.is_command(command, tmx.GS_8L) and command[8] == 112]
+        self.assertLess(received[3], 2.0)       # The first page takes 3 s to print.
+
+    def test_checkpoint_of_another_band_length_is_discarded(self):
+        for text in ('Job=7\nBandLines=128\nCheckpoint=4\n', 'Job=7\nCheckpoint=4\n'):
+            write_checkpoint(text)
+            result = FakePrinter().run(receipt(), OPTIONS)
+            self.assertEqual(result.returncode, 0, result.log)
+            self.assertEqual(bands(result), bands(self.complete))
+            self.assertEqual(result.find(tmx.DLE_DC4_CLEAR), [])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,60 @@
+"""Printer state left for the next job (State.dat) and skipping ESC @ between jobs."""
+
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 576
+ESC_AT = b'\x1b@'
+
+
+def receipt():
+    return tmx.raster([(WIDTH, tmx.text(WIDTH, 100))])
+
+
+class StatusChangingPrinter(FakePrinter):
+    """The paper runs low (DLE EOT 4 : paper near end) while the job prints."""
+
+    def answer(self, command):
+        if tmx.is_command(command, tmx.GS_8L):
+            self.status[4] = 0x1e
+        return FakePrinter.answer(self, command)
+
+
+class StrayReplyPrinter(FakePrinter):
+    """A late reply of an earlier command arrives before the status."""
+
+    def answer(self, command):
+        data, realtime = FakePrinter.answer(self, command)
+        if command == tmx.DLE_EOT + b'\x01':
+            data = b'\x37' + data
+        return data, realtime
+
+
+class StateTest(unittest.TestCase):
+    def setUp(self):
+        tmx.clear_data_dir()
+
+    def test_initialization_is_skipped(self):
+        first = FakePrinter().run(receipt(), job=1)
+        second = FakePrinter().run(receipt(), job=2)
+        self.assertEqual(first.returncode, 0, first.log)
+        self.assertEqual(second.returncode, 0, second.log)
+        self.assertEqual(len(first.find(ESC_AT)), 1)
+        self.assertEqual(second.find(ESC_AT), [])
+
+    def test_status_at_job_end_is_recorded(self):
+        result = StatusChangingPrinter().run(receipt())
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(tmx.data_file('State')['Status'], '1612121e')
+
+    def test_stray_reply_initializes_the_printer(self):
+        FakePrinter().run(receipt(), job=1)
+        result = StrayReplyPrinter().run(receipt(), job=2)
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertEqual(len(result.find(ESC_AT)), 1)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,223 @@
+"""Solid fill thinning (TmxSolidThinning) and the print speed of thinned bands.
+
+The visual diff renders the output with and without thinning and checks every removed dot. Set TMX_TEST_OUTPUT
+to a directory to also get the images (off.pbm, <mode>.pbm, <mode>-diff.pbm).
+"""
+
+import os
+import re
+import tempfile
+import unittest
+
+import tmx
+from tmx import FakePrinter
+
+WIDTH = 576
+
+
+def receipt():
+    """Text, an inverted header with white text, a filled logo and more text. (The last band has no solid area)"""
+    rows = tmx.text(WIDTH, 900)
+    rows[120:560] = tmx.blank(WIDTH, 440)
+    rows = tmx.solid(WIDTH, 900, 16, 130, WIDTH - 16, 230, rows)
+    rows = tmx.solid(WIDTH, 900, 160, 280, 416, 520, rows)
+    header = [bytearray(r) for r in rows]
+    for y in range(160, 200):       # White text in the header
+        for x in range(8, 64, 3):
+            header[y][x] = 0x81
+    return [bytes(r) for r in header]
+
+
+def full_bytes(row, x):
+    """True if the 8 dots of the byte containing dot x are black."""
+    start = x - x % 8
+    return all(d in row for d in range(start, start + 8))
+
+
+def speeds_of_bands(result):
+    """GS ( K level (0 : customized) in effect for each band."""
+    speed, speeds = 0, []
+    for command in result.commands:
+        if tmx.is_command(command, tmx.GS_K_SPEED):
+            speed = command[6]
+        elif tmx.is_command(command, tmx.GS_8L):
+            speeds.append(speed)
+    return speeds
+
+
+def bands(result):
+    return [command[17:] for command in result.find(tmx.GS_8L)]
+
+
+def density(band):
+    """Black dots of band data in percent."""
+    return 100.0 * sum(bin(b).count('1') for b in band) / (len(band) * 8)
+
+
+def line_time(dots, level):
+    """Throughput model of the head (time units per dot line).
+
+    A line takes the longer of the line time of the speed level and the time to deliver the energy of its dots.
+    Level n prints n lines per time unit, the customized speed is taken as level 5. A fully black line needs
+    2 time units of energy.
+    """
+    return max(1.0 / (level or 5), 2.0 * dots / WIDTH)
+
+
+def print_time(result):
+    speed, total, stored = 0, 0.0, None
+    for command in result.commands:
+        if tmx.is_command(command, tmx.GS_K_SPEED):
+            speed = command[6]
+        elif tmx.is_command(command, tmx.GS_8L):
+            stored = command
+        elif command == tmx.GS_L_PRINT:
+            for row in tmx.render(stored + tmx.GS_L_PRINT):
+                total += line_time(len(row), speed)
+        elif tmx.is_command(command, b'\x1bJ'):
+            total += command[2] * line_time(0, speed)
+    return total
+
+
+class ThinningTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        tmx.clear_data_dir()
+        cls.raster = tmx.raster([(WIDTH, receipt())])
+        cls.off = FakePrinter().run(cls.raster, 'TmxSolidThinning=Off')
+        cls.off_rows = tmx.render(cls.off.output)
+
+    def thinned(self, mode, ppd=tmx.PPD_203):
+        result = FakePrinter().run(self.raster, 'TmxSolidThinning=' + mode, ppd)
+        self.assertEqual(result.returncode, 0, result.log)
+        return result
+
+    def visual_diff(self, mode):
+        result = self.thinned(mode)
+        rows = tmx.render(result.output)
+        self.assertEqual(len(rows), len(self.off_rows))
+
+        removed = []
+        for y, (before, after) in enumerate(zip(self.off_rows, rows)):
+            if before == 'CUT' or after == 'CUT':
+                self.assertEqual(before, after)
+                continue
+            self.assertLessEqual(set(after), set(before), 'row %d has new dots' % y)
+            removed.append(sorted(set(before) - set(after)))
+
+        output = os.environ.get('TMX_TEST_OUTPUT')
+        if output:
+            os.makedirs(output, exist_ok=True)
+            tmx.write_pbm(os.path.join(output, 'off.pbm'), self.off_rows, WIDTH)
+            tmx.write_pbm(os.path.join(output, mode + '.pbm'), rows, WIDTH)
+            tmx.write_pbm(os.path.join(output, mode + '-diff.pbm'), [tuple(r) for r in removed], WIDTH)
+        return result, removed
+
+    def check_interior(self, removed, vertical):
+        for y, dots in enumerate(removed):
+            for x in dots:
+                row = self.off_rows[y]
+                self.assertTrue(full_bytes(row, x - 8) and full_bytes(row, x) and full_bytes(row, x + 8),
+                                'edge dot %d,%d removed' % (x, y))
+                if vertical:
+                    self.assertTrue(full_bytes(self.off_rows[y - 1], x) and full_bytes(self.off_rows[y + 1], x),
+                                    'top or bottom dot %d,%d removed' % (x, y))
+
+    def check_reduction(self, removed, top, bottom):
+        area = sum(len(row) for row in self.off_rows[top:bottom])
+        thinned = sum(len(dots) for dots in removed[top:bottom])
+        self.assertGreater(thinned, area * 0.35)
+        self.assertLess(thinned, area * 0.5)
+
+    def test_checkerboard(self):
+        result, removed = self.visual_diff('Checkerboard')
+        self.check_interior(removed, vertical=False)
+        top = self.off_rows.index(next(r for r in self.off_rows if r))
+        self.assertEqual(removed[top:top + 120 - 8], [[]] * (120 - 8))      # Text
+        self.check_reduction(removed, top + 280 - 8, top + 520 - 8)            # Logo
+
+    def test_edge_preserving(self):
+        result, removed = self.visual_diff('EdgePreserving')
+        self.check_interior(removed, vertical=True)
+        top = self.off_rows.index(next(r for r in self.off_rows if r))
+        self.assertEqual(removed[top + 280 - 8], [])                           # Top line of the logo
+        self.assertEqual(removed[top + 520 - 8 - 1], [])                       # Bottom line of the logo
+        self.check_reduction(removed, top + 281 - 8, top + 519 - 8)
+
+    def test_speed_follows_thinned_bands(self):
+        result = self.thinned('Checkerboard')
+        changed = [a != b for a, b in zip(bands(self.off), bands(result))]
+        self.assertIn(True, changed)
+        self.assertIn(False, changed)
+        fast = [c and density(band) <= 25 for c, band in zip(changed, bands(result))]
+        self.assertIn(True, fast)
+        self.assertIn(False, [f for c, f in zip(changed, fast) if c])      # The header is still dense.
+        self.assertEqual(speeds_of_bands(result), [9 if f else 0 for f in fast])
+        self.assertEqual(self.off.find(tmx.GS_K_SPEED), [])
+
+        # The customized speed is restored at the end of the page.
+        self.assertEqual(result.find(tmx.GS_K_SPEED)[-1], tmx.GS_K_SPEED + b'\x00')
+
+    def test_speed_is_limited_by_the_model(self):
+        with open(tmx.PPD_203) as fp:
+            ppd = fp.read()
+        with tempfile.NamedTemporaryFile('w', suffix='.ppd') as slow, \
+                tempfile.NamedTemporaryFile('w', suffix='.ppd') as unknown, \
+                tempfile.NamedTemporaryFile('w', suffix='.ppd') as invalid:
+            slow.write(re.sub(r'\*TmxMaxPrintSpeed: "\d+"', '*TmxMaxPrintSpeed: "4"', ppd))
+            unknown.write(re.sub(r'\*TmxMaxPrintSpeed: "\d+"\n', '', ppd))
+            invalid.write(re.sub(r'\*TmxMaxPrintSpeed: "\d+"', '*TmxMaxPrintSpeed: "20"', ppd))
+            for fp in (slow, unknown, invalid):
+                fp.flush()
+
+            self.assertEqual(set(speeds_of_bands(self.thinned('Checkerboard', slow.name))), {0, 4})
+
+            result = self.thinned('Checkerboard', unknown.name)
+            self.assertEqual(result.find(tmx.GS_K_SPEED), [])
+            self.assertEqual(bands(result), bands(self.thinned('Checkerboard')))
+
+            result = FakePrinter().run(self.raster, 'TmxSolidThinning=Checkerboard', invalid.name)
+            self.assertNotEqual(result.returncode, 0)
+            self.assertIn('Error Code=4105', result.log)
+
+    def test_throughput(self):
+        off = print_time(self.off)
+        for mode in ('Checkerboard', 'EdgePreserving'):
+            thinned = print_time(self.thinned(mode))
+            print('\n  %s : %.1f -> %.1f time units (%.0f%%)' % (mode, off, thinned, 100.0 * thinned / off), end='')
+            self.assertLess(thinned, off * 0.85)
+
+    def test_dense_band_stays_at_customized_speed(self):
+        rows = [b'\x7e' * (WIDTH // 8)] * 256                      # 75 % without solid bytes
+        rows = tmx.solid(WIDTH, 256, 160, 0, 200, 256, rows)        # A narrow solid bar
+        raster = tmx.raster([(WIDTH, rows)])
+        off = FakePrinter().run(raster, 'TmxSolidThinning=Off')
+        result = FakePrinter().run(raster, 'TmxSolidThinning=Checkerboard')
+        self.assertEqual(result.returncode, 0, result.log)
+        self.assertNotEqual(bands(result), bands(off))
+        self.assertEqual(set(speeds_of_bands(result)), {0})
+
+    def test_doubled_band_stays_doubled(self):
+        rows = tmx.solid(WIDTH, 256, 160, 0, 416, 256)              # An upscaled logo (even edges, 256 lines)
+        raster = tmx.raster([(WIDTH, rows)])
+        off = FakePrinter().run(raster, 'TmxSolidThinning=Off')
+        off_rows = tmx.render(off.output)
+        for mode in ('Checkerboard', 'EdgePreserving'):
+            result = FakePrinter().run(raster, 'TmxSolidThinning=' + mode)
+            self.assertEqual(result.returncode, 0, result.log)
+            self.assertEqual([(band[10], band[11]) for band in result.find(tmx.GS_8L)], [(2, 2)])
+            rows = tmx.render(result.output)
+            self.assertEqual(len(rows), len(off_rows))
+            self.assertTrue(all(set(a) <= set(b) for a, b in zip(rows, off_rows)))
+            removed = sum(len(b) - len(a) for a, b in zip(rows, off_rows) if a != 'CUT')
+            self.assertGreater(removed, 256 * 256 * 0.35)
+
+    def test_text_is_not_changed(self):
+        raster = tmx.raster([(WIDTH, tmx.text(WIDTH, 400))])
+        off = FakePrinter().run(raster, 'TmxSolidThinning=Off')
+        thinned = FakePrinter().run(raster, 'TmxSolidThinning=Checkerboard')
+        self.assertEqual(thinned.output, off.output)
+
+
+if __name__ == '__main__':
+    unittest.main()
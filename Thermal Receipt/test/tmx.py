@@ -0,0 +1,362 @@
+"""Helpers for the filter tests.
+
+- raster()      : CUPS raster stream (RaS3) from 1 bit per dot bitmaps
+- FakePrinter   : scripted ESC/POS printer on the CUPS backchannel (fd 3) of the filter
+- commands()    : splits the ESC/POS stream written by the filter into commands
+- render()      : dot rows the printer would print from the stream
+"""
+
+import os
+import select
+import struct
+import subprocess
+import tempfile
+import threading
+import time
+
+TEST_DIR = os.path.dirname(os.path.abspath(__file__))
+BUILD_DIR = os.environ.get('TMX_BUILD_DIR', os.path.join(TEST_DIR, 'build'))
+FILTER = os.path.join(BUILD_DIR, os.environ.get('TMX_FILTER', 'rastertotmtr'))
+DATA_DIR = os.path.join(BUILD_DIR, 'data')  # EPTMD_DATA_DIR of the test build
+PPD_203 = os.path.join(TEST_DIR, '..', 'ppd', 'tm-ba-thermal-rastertotmtr-203.ppd')
+PPD_180 = os.path.join(TEST_DIR, '..', 'ppd', 'tm-ba-thermal-rastertotmtr-180.ppd')
+PRINTER = 'tm'
+
+DLE, ESC, GS = 0x10, 0x1b, 0x1d
+
+
+def clear_data_dir():
+    os.makedirs(DATA_DIR, exist_ok=True)
+    for name in os.listdir(DATA_DIR):
+        os.unlink(os.path.join(DATA_DIR, name))
+
+
+def data_file(kind):
+    """Contents of <printer>_<kind>.dat as a dict, or None."""
+    path = os.path.join(DATA_DIR, '%s_%s.dat' % (PRINTER, kind))
+    if not os.path.exists(path):
+        return None
+    with open(path) as fp:
+        return dict(line.rstrip('\n').split('=', 1) for line in fp if '=' in line)
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+# Raster
+# ---------------------------------------------------------------------------------------------------------------------
+
+def page_header(width, height, resolution=203):
+    words = [0] * 81
+    words[5] = words[6] = resolution        # HWResolution
+    words[21] = 1                           # NumCopies
+    words[29], words[30] = width, height    # cupsWidth, cupsHeight
+    words[32] = words[33] = 1               # cupsBitsPerColor, cupsBitsPerPixel
+    words[34] = (width + 7) // 8            # cupsBytesPerLine
+    words[36] = 3                           # cupsColorSpace = CUPS_CSPACE_K
+    header = bytes(256) + struct.pack('<81I', *words)
+    return header + bytes(1796 - len(header))
+
+
+def raster(pages, resolution=203):
+    """pages : list of (width, rows). rows : list of bytes, 1 bit per dot, MSB first."""
+    out = bytearray(b'3SaR')
+    for width, rows in pages:
+        out += page_header(width, len(rows), resolution)
+        for row in rows:
+            out += row
+    return bytes(out)
+
+
+def blank(width, height):
+    return [bytes((width + 7) // 8)] * height
+
+
+def text(width, height, seed=1):
+    """Text like pattern : glyph rows of scattered dots with blank leading between them."""
+    rows = []
+    state = seed
+    for y in range(height):
+        row = bytearray((width + 7) // 8)
+        if (y // 8) % 3 != 0:
+            for x in range(len(row)):
+                state = (state * 1103515245 + 12345) & 0x7fffffff
+                row[x] = (state >> 16) & 0x5a
+        rows.append(bytes(row))
+    return rows
+
+
+def solid(width, height, left, top, right, bottom, base=None):
+    """Filled rectangle (dots left <= x < right, top <= y < bottom) over base rows."""
+    rows = [bytearray(r) for r in (base or blank(width, height))]
+    for y in range(top, bottom):
+        for x in range(left, right):
+            rows[y][x // 8] |= 0x80 >> (x % 8)
+    return [bytes(r) for r in rows]
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+# ESC/POS stream
+# ---------------------------------------------------------------------------------------------------------------------
+
+_FIXED = {
+    (ESC, ord('@')): 2, (ESC, ord('J')): 3, (ESC, ord('=')): 3, (ESC, ord('$')): 4, (ESC, ord('c')): 4,
+    (ESC, ord('p')): 5, (GS, ord('I')): 3, (GS, ord('P')): 4,
+}
+
+
+def command_length(data, i):
+    """Length of the command at data[i], or 0 if it is not complete yet. Unknown bytes are 1 byte long."""
+    n = len(data) - i
+
+    def need(length):
+        return length if n >= length else 0
+
+    if data[i] == DLE:
+        if n < 3:
+            return 0
+        if data[i + 1] in (0x04, 0x05):                            # DLE EOT, DLE ENQ
+            return 3
+        if data[i + 1] == 0x14:                                    # DLE DC4 fn
+            return need(10 if data[i + 2] == 8 else 5)
+        return 1
+    if data[i] in (ESC, GS):
+        if n < 2:
+            return 0
+        c = data[i + 1]
+        if c == ord('('):                                          # ESC ( / GS ( <fn> pL pH ...
+            return need(5 + data[i + 3] + (data[i + 4] << 8)) if n >= 5 else 0
+        if data[i] == GS and c == ord('8'):                        # GS 8 L p1 p2 p3 p4 ...
+            return need(7 + int.from_bytes(data[i + 3:i + 7], 'little')) if n >= 7 else 0
+        if data[i] == ESC and c == ord('*'):                       # ESC * m nL nH ...
+            if n < 5:
+                return 0
+            return need(5 + (data[i + 3] | data[i + 4] << 8) * (1 if data[i + 2] in (0, 1) else 3))
+        if data[i] == GS and c == ord('v'):                        # GS v 0 m xL xH yL yH ...
+            if n < 8:
+                return 0
+            return need(8 + (data[i + 4] | data[i + 5] << 8) * (data[i + 6] | data[i + 7] << 8))
+        if data[i] == GS and c == ord('V'):                        # GS V m [n]
+            return need(4 if data[i + 2] in (65, 66, 97, 98, 103, 104) else 3) if n >= 3 else 0
+        length = _FIXED.get((data[i], c))
+        return need(length) if length else 1
+    return 1
+
+
+def commands(data):
+    """List of (offset, command bytes)."""
+    result = []
+    i = 0
+    while i < len(data):
+        length = command_length(data, i) or (len(data) - i)
+        result.append((i, bytes(data[i:i + length])))
+        i += length
+    return result
+
+
+def is_command(command, prefix):
+    return command[:len(prefix)] == prefix
+
+
+GS_8L = b'\x1d8L'
+GS_V0 = b'\x1dv0'
+GS_L_PRINT = b'\x1d(L\x02\x00\x30\x32'
+GS_L_CAPACITY = b'\x1d(L\x02\x00\x30\x34'
+GS_I = b'\x1dI'
+GS_H_ID = b'\x1d(H\x06\x00\x30\x30'
+GS_K_SPEED = b'\x1d(K\x02\x00\x32'
+DLE_EOT = b'\x10\x04'
+DLE_DC4 = b'\x10\x14'
+DLE_DC4_CLEAR = b'\x10\x14\x08'
+
+
+def render(data):
+    """Dot rows printed from the stream. A row is a tuple of dot columns; 'CUT' marks a cut."""
+    rows = []
+    stored = None
+
+    def emit(width, height, bitmap, bx, by):
+        bpl = (width + 7) // 8
+        for y in range(height):
+            line = bitmap[y * bpl:(y + 1) * bpl]
+            dots = tuple(x * bx + k for x in range(width) if line[x // 8] & (0x80 >> (x % 8)) for k in range(bx))
+            rows.extend([dots] * by)
+
+    for _, command in commands(data):
+        if is_command(command, GS_8L) and command[8] == 112:      # Store raster graphics
+            bx, by = command[10], command[11]
+            width = command[13] | command[14] << 8
+            height = command[15] | command[16] << 8
+            stored = (width, height, command[17:], bx, by)
+        elif command == GS_L_PRINT and stored:
+            emit(*stored)
+        elif is_command(command, GS_V0):
+            m = command[3]
+            width = (command[4] | command[5] << 8) * 8
+            height = command[6] | command[7] << 8
+            emit(width, height, command[8:], 2 if m & 1 else 1, 2 if m & 2 else 1)
+        elif is_command(command, b'\x1bJ'):
+            rows.extend([()] * command[2])
+        elif is_command(command, b'\x1dV'):
+            rows.append('CUT')
+    return rows
+
+
+def write_pbm(path, rows, width):
+    """Writes rendered rows as a PBM image (cuts are drawn as a gray dashed line)."""
+    with open(path, 'wb') as fp:
+        fp.write(b'P1\n%d %d\n' % (width, len(rows)))
+        for row in rows:
+            dots = set(range(0, width, 2)) if row == 'CUT' else set(row)
+            fp.write(b' '.join(b'1' if x in dots else b'0' for x in range(width)) + b'\n')
+
+
+# ---------------------------------------------------------------------------------------------------------------------
+# Fake printer
+# ---------------------------------------------------------------------------------------------------------------------
+
+class Result:
+    def __init__(self, returncode, output, log, unread, elapsed):
+        self.returncode = returncode
+        self.output = bytes(output)
+        self.log = log
+        self.unread = unread        # Backchannel bytes the filter did not read
+        self.elapsed = elapsed
+        self.commands = [command for _, command in commands(self.output)]
+
+    def find(self, prefix):
+        return [command for command in self.commands if is_command(command, prefix)]
+
+
+class FakePrinter:
+    """Answers the queries of the filter like a TM printer.
+
+    Commands are processed in order. Answers to the other commands wait until the printer is not busy,
+    real-time commands (DLE EOT, DLE DC4) are executed and answered at once.
+      busy       : seconds the printer is busy (with a previous job) when the job starts
+      stall      : {command prefix : seconds} the printer is busy after processing the command
+      mute       : the printer never answers
+      backchannel: False gives the filter /dev/null as fd 3 (backend without backchannel)
+      gs_l       : the printer supports GS ( L / GS 8 L
+      status     : DLE EOT n -> status byte
+      drop_after : the connection is lost after this many bytes
+      pause      : (bytes, seconds) the printer stops reading for seconds after this many bytes
+    """
+
+    def __init__(self, busy=0.0, stall=None, mute=False, backchannel=True, gs_l=True, status=None,
+                 drop_after=None, model_id=0x20, model_name=b'TM-FAKE', capacity=65536, pause=None):
+        self.busy = busy
+        self.stall = stall or {}
+        self.mute = mute
+        self.backchannel = backchannel
+        self.gs_l = gs_l
+        self.status = {1: 0x16, 2: 0x12, 3: 0x12, 4: 0x12}
+        self.status.update(status or {})
+        self.drop_after = drop_after
+        self.pause = pause
+        self.model_id = model_id
+        self.model_name = model_name
+        self.capacity = capacity
+        self.received = []          # (seconds, command)
+        self.executed = []          # (seconds, command)
+
+    def answer(self, command):
+        """(answer, real-time)"""
+        if is_command(command, DLE_EOT):
+            return bytes([self.status.get(command[2], 0x12)]), True
+        if command == GS_I + b'\x01':
+            return bytes([self.model_id]), False
+        if command == GS_I + b'\x43':
+            return b'_' + self.model_name + b'\x00', False
+        if command == GS_L_CAPACITY:
+            return (b'\x37\x34' + str(self.capacity).encode() + b'\x00') if self.gs_l else b'', False
+        if is_command(command, GS_H_ID):
+            return b'\x37\x22' + command[7:11] + b'\x00', False
+        if is_command(command, DLE_DC4_CLEAR):
+            return b'\x37\x25\x00', True
+        if is_command(command, DLE_DC4):
+            return b'', True
+        return b'', False
+
+    def run(self, raster_data, options='', ppd=PPD_203, job=7, env=None):
+        with tempfile.NamedTemporaryFile(suffix='.ras') as fp, tempfile.TemporaryFile() as log:
+            fp.write(raster_data)
+            fp.flush()
+            return self._run([PRINTER, str(job), 'user', 'title', '1', options, fp.name], ppd, env, log)
+
+    def _run(self, argv, ppd, env, log):
+        bc_read, bc_write = os.pipe()
+        environment = dict(os.environ, PPD=ppd)
+        environment.update(env or {})
+
+        def backchannel():
+            if self.backchannel:
+                os.dup2(bc_read, 3)
+            else:
+                os.dup2(os.open(os.devnull, os.O_RDONLY), 3)
+
+        start = time.time()
+        process = subprocess.Popen(argv, executable=FILTER, stdout=subprocess.PIPE, stderr=log, env=environment,
+                                   close_fds=False, preexec_fn=backchannel)
+        lock = threading.Lock()
+        timers = []
+        ready = [start + self.busy]    # The printer processes the data in order.
+
+        def send(data):
+            with lock:
+                try:
+                    os.write(bc_write, data)
+                except OSError:
+                    pass
+
+        output = bytearray()
+        position = 0
+        while True:
+            chunk = process.stdout.read1(65536)
+            if not chunk:
+                break
+            output += chunk
+            if self.drop_after is not None and len(output) >= self.drop_after:
+                del output[self.drop_after:]
+                process.stdout.close()
+                break
+            if self.pause is not None and len(output) >= self.pause[0]:
+                time.sleep(self.pause[1])
+                self.pause = None
+            while position < len(output):
+                length = command_length(output, position)
+                if length == 0:
+                    break
+                command = bytes(output[position:position + length])
+                position += length
+                now = time.time()
+                self.received.append((now - start, command))
+                data, realtime = self.answer(command)
+                if not realtime:
+                    ready[0] = max(ready[0], now)
+                self.executed.append(((now if realtime else ready[0]) - start, command))
+                if not realtime:
+                    for prefix, seconds in self.stall.items():
+                        if is_command(command, prefix):
+                            ready[0] += seconds
+                if self.mute or not data:
+                    continue
+                delay = 0.0 if realtime else ready[0] - now
+                if delay <= 0.0:
+                    send(data)
+                else:
+                    timer = threading.Timer(delay, send, (data,))
+                    timer.start()
+                    timers.append(timer)
+        process.wait()
+        elapsed = time.time() - start
+        for timer in timers:
+            timer.cancel()
+
+        unread = b''
+        while select.select([bc_read], [], [], 0)[0]:
+            unread += os.read(bc_read, 4096)
+        os.close(bc_read)
+        os.close(bc_write)
+        if not process.stdout.closed:
+            process.stdout.close()
+        log.seek(0)
+        return Result(process.returncode, output, log.read().decode(errors='replace'), unread, elapsed)